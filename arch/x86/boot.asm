@@ -2,6 +2,26 @@
 [bits 16]
 [org 0x7C00]
 
+E820_MAP_ADDR equ 0x8000    ; Memory map handed to the kernel: dword count, then 24-byte entries
+E820_MAX_ENTRIES equ 32
+KERNEL_LOAD_SEG equ 0x1000  ; Kernel is linked and loaded at 0x10000
+SECTORS_PER_TRACK equ 18    ; 1.44MB floppy: 18 sectors per track, 2 heads
+
+; Sectors read for the kernel image; the Makefile passes the same value and
+; refuses to build a kernel.bin that does not fit.
+%ifndef KERNEL_SECTORS
+%define KERNEL_SECTORS 384
+%endif
+
+; The kernel image must not overwrite the E820 map collected before it is loaded,
+; nor run into the protected mode stack below 0x90000.
+%if E820_MAP_ADDR + 4 + E820_MAX_ENTRIES * 24 > KERNEL_LOAD_SEG * 16
+%error "E820 map overlaps the kernel load address"
+%endif
+%if KERNEL_LOAD_SEG * 16 + KERNEL_SECTORS * 512 > 0x80000
+%error "KERNEL_SECTORS reaches the protected mode stack"
+%endif
+
 ; Initialize segment registers
 _start:
     cli                 ; Disable interrupts
@@ -15,6 +35,32 @@ _start:
     mov si, boot_msg
     call print_string
 
+; Collect the BIOS E820 memory map (ES is still 0 here)
+detect_memory:
+    mov di, E820_MAP_ADDR + 4
+    xor ebx, ebx        ; Continuation value, 0 starts the list
+    xor bp, bp          ; Number of entries stored
+.next_entry:
+    mov eax, 0xE820
+    mov edx, 0x534D4150 ; 'SMAP'
+    mov ecx, 24
+    mov dword [di + 20], 1 ; Extended attributes default to "valid" for 20-byte BIOSes
+    int 0x15
+    jc .done            ; Carry: unsupported or past the last entry
+    cmp eax, 0x534D4150
+    jne .done
+    jcxz .skip          ; Ignore empty responses
+    inc bp
+    add di, 24
+.skip:
+    test ebx, ebx       ; EBX = 0 after the last entry
+    jz .done
+    cmp bp, E820_MAX_ENTRIES
+    jb .next_entry
+.done:
+    mov [E820_MAP_ADDR], bp
+    mov word [E820_MAP_ADDR + 2], 0
+
 ; Load kernel from floppy disk
 load_kernel:
     ; Reset floppy disk system
@@ -23,22 +69,42 @@ load_kernel:
     int 0x13
     jc disk_error       ; If reset failed, show error
     
-    ; Load kernel (read more sectors to accommodate larger kernel)
-    mov ah, 0x02        ; BIOS read sector function
-    mov al, 80          ; Number of sectors to read (80 sectors = 40KB, enough for kernel with process management)
+    ; Read the kernel one sector at a time, walking CHS by hand. Each read lands at
+    ; ES:0 with ES advanced by 512 bytes, so no transfer crosses a 64KB DMA boundary
+    ; and images larger than one segment load correctly.
+    mov bx, KERNEL_LOAD_SEG
+    mov es, bx
+    xor bx, bx          ; Buffer offset stays 0
     mov ch, 0           ; Cylinder 0
     mov cl, 2           ; Start from sector 2 (sector 1 is bootloader)
     mov dh, 0           ; Head 0
+    mov si, KERNEL_SECTORS
+.read_sector:
+    mov di, 3           ; Floppy reads may fail while the motor spins up
+.retry:
+    mov ax, 0x0201      ; BIOS read sector function, 1 sector
     mov dl, 0x00        ; First floppy disk
-    mov bx, 0x1000      ; Load kernel at 0x10000
-    mov es, bx
-    xor bx, bx
-    int 0x13            ; BIOS disk interrupt
-    jc disk_error       ; Jump if carry flag set (error)
-    
-    ; Verify we loaded something
-    cmp ax, 80          ; Check if we read the expected number of sectors
-    jne disk_error
+    int 0x13
+    jnc .advance
+    xor ah, ah          ; Reset disk system and try again
+    int 0x13
+    dec di
+    jnz .retry
+    jmp disk_error
+.advance:
+    mov ax, es
+    add ax, 512 / 16    ; Next sector's buffer
+    mov es, ax
+    inc cl
+    cmp cl, SECTORS_PER_TRACK
+    jbe .next
+    mov cl, 1           ; Wrap to sector 1 on the other head
+    xor dh, 1
+    jnz .next
+    inc ch              ; Both heads done, next cylinder
+.next:
+    dec si
+    jnz .read_sector
 
 ; Switch to protected mode
 switch_to_pm:
@@ -59,7 +125,8 @@ protected_mode:
     mov ss, ax
     mov esp, 0x90000    ; Set stack pointer for protected mode
 
-; Jump to kernel
+; Jump to kernel, passing the E820 map as the first argument
+    push dword E820_MAP_ADDR
     call 0x10000        ; Call kernel entry point
     jmp $               ; Infinite loop if kernel returns
 
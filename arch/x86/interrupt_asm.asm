@@ -6,6 +6,7 @@ extern interrupt_handler_common
 extern exception_handler_common
 extern timer_handler
 extern keyboard_handler
+extern page_fault_handler
 
 ; 通用中断处理程序入口点
 global interrupt_handler_0
@@ -82,13 +83,25 @@ INTERRUPT_HANDLER 10  ; 无效TSS
 INTERRUPT_HANDLER 11  ; 段不存在
 INTERRUPT_HANDLER 12  ; 堆栈故障
 INTERRUPT_HANDLER 13  ; 一般保护故障
-INTERRUPT_HANDLER 14  ; 页故障
 INTERRUPT_HANDLER 15  ; 保留
 INTERRUPT_HANDLER 16  ; FPU错误
 INTERRUPT_HANDLER 17  ; 对齐检查
 INTERRUPT_HANDLER 18  ; 机器检查
 INTERRUPT_HANDLER 19  ; SIMD FPU错误
 
+; 页故障：CPU压入了错误码，交给C处理程序后需要在iret前弹出
+interrupt_handler_14:
+    cli
+    SAVE_REGS
+    
+    push dword [esp + 28]   ; 错误码位于保存的7个寄存器之上
+    call page_fault_handler
+    add esp, 4
+    
+    RESTORE_REGS
+    add esp, 4              ; 丢弃错误码
+    iret
+
 ; 可屏蔽中断处理程序
 interrupt_handler_32:  ; 定时器中断
     cli
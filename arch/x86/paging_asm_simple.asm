@@ -7,6 +7,8 @@ section .text
     global disable_paging_asm
     global invalidate_tlb_asm
     global invalidate_page_asm
+    global cpu_has_pse_asm
+    global enable_pse_asm
 
 ; Load page directory into CR3
 ; void load_page_directory(uint32_t page_dir)
@@ -21,12 +23,13 @@ load_page_directory:
     ret
 
 ; Enable paging by setting CR0.PG bit
+; CR0.WP is set as well so that ring 0 honours read-only (copy-on-write) pages
 enable_paging_asm:
     push ebp
     mov ebp, esp
     
     mov eax, cr0
-    or eax, 0x80000000    ; Set PG bit (bit 31)
+    or eax, 0x80010000    ; Set PG bit (bit 31) and WP bit (bit 16)
     mov cr0, eax
     
     pop ebp
@@ -68,6 +71,36 @@ invalidate_page_asm:
     pop ebp
     ret
 
+; Check CPUID for 4MB page support (leaf 1, EDX bit 3)
+; bool cpu_has_pse_asm(void)
+cpu_has_pse_asm:
+    push ebp
+    mov ebp, esp
+    push ebx              ; CPUID clobbers EBX, which is callee-saved
+    
+    mov eax, 1
+    cpuid
+    mov eax, edx
+    shr eax, 3            ; Move PSE bit to position 0
+    and eax, 1
+    
+    pop ebx
+    pop ebp
+    ret
+
+; Enable 4MB page directory entries by setting CR4.PSE
+; Must run before paging is enabled with large entries present
+enable_pse_asm:
+    push ebp
+    mov ebp, esp
+    
+    mov eax, cr4
+    or eax, 0x10          ; Set PSE bit (bit 4)
+    mov cr4, eax
+    
+    pop ebp
+    ret
+
 ; Note: get_current_page_directory is implemented in C (memory.c)
 
 ; Check if paging is enabled
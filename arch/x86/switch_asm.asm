@@ -0,0 +1,36 @@
+; switch_asm.asm - Kernel thread context switch
+; Only the callee-saved registers need to survive a call, so they are all
+; that is kept on each thread's stack; ESP itself lives in the PCB.
+
+section .text
+    global switch_to_asm
+    global fork_return_asm
+    extern process_fork_return
+    extern syscall_return
+
+; Save the current thread and resume another one
+; void switch_to_asm(uint32_t* old_esp, uint32_t new_esp)
+; A new thread's stack holds zeroed registers followed by the address of
+; its bootstrap function, so the final ret starts it.
+switch_to_asm:
+    mov eax, [esp + 4]    ; Where to store the old stack pointer
+    mov edx, [esp + 8]    ; Stack pointer to resume
+    
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [eax], esp
+    
+    mov esp, edx
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; First return of a forked child: switch_to_asm's ret lands here with ESP
+; pointing at the child's copy of the parent's int 0x80 trap frame.
+fork_return_asm:
+    call process_fork_return
+    jmp syscall_return
@@ -13,10 +13,11 @@
 ; 返回值通过 eax 返回
 
 global syscall_entry
-extern syscall_execute
+global syscall_return
+extern syscall_dispatch
 
 syscall_entry:
-    ; 保存所有寄存器
+    ; 保存所有寄存器，和CPU压入的eip/cs/eflags一起组成陷阱帧（trap_frame_t）
     push eax
     push ebx
     push ecx
@@ -25,17 +26,13 @@ syscall_entry:
     push edi
     push ebp
     
-    ; 调用C语言系统调用处理函数
-    ; 参数通过寄存器传递：eax=syscall_num, ebx=arg1, ecx=arg2, edx=arg3, esi=arg4, edi=arg5
-    push edi    ; arg5
-    push esi    ; arg4
-    push edx    ; arg3
-    push ecx    ; arg2
-    push ebx    ; arg1
-    push eax    ; syscall_num
-    call syscall_execute
-    add esp, 24 ; 清理栈（6个参数 * 4字节）
+    ; 调用C语言分发函数，参数为陷阱帧地址；返回值写入帧中保存的eax
+    push esp
+    call syscall_dispatch
+    add esp, 4
     
+; fork出的子进程经fork_return_asm从这里返回
+syscall_return:
     ; 恢复所有寄存器
     pop ebp
     pop edi
@@ -79,6 +76,8 @@ global syscall_malloc
 global syscall_free
 global syscall_mmap
 global syscall_munmap
+global syscall_brk
+global syscall_sbrk
 
 global syscall_ps
 global syscall_setpriority
@@ -217,6 +216,25 @@ syscall_munmap:
     int 0x80
     ret
 
+; brk/sbrk按cdecl从栈上取参数放入ebx（用户态malloc使用）
+; int32_t syscall_brk(uint32_t addr)
+syscall_brk:
+    push ebx
+    mov ebx, [esp + 8]
+    mov eax, 34     ; SYS_BRK
+    int 0x80
+    pop ebx
+    ret
+
+; int32_t syscall_sbrk(int32_t increment)
+syscall_sbrk:
+    push ebx
+    mov ebx, [esp + 8]
+    mov eax, 35     ; SYS_SBRK
+    int 0x80
+    pop ebx
+    ret
+
 ; 进程管理相关系统调用包装函数
 syscall_ps:
     mov eax, 40     ; SYS_PS
@@ -1,11 +1,14 @@
 #include "interrupt.h"
 #include "../drivers/vga/vga.h"
 #include "../drivers/keyboard/keyboard.h"
+#include "memory.h"
+#include "process/process.h"
 #include <stddef.h>
 
 // 外部汇编处理程序声明
 extern void interrupt_handler_32(void);
 extern void interrupt_handler_33(void);
+extern void interrupt_handler_14(void);
 extern void syscall_entry(void);
 
 // IDT表 (256个条目)
@@ -39,15 +42,16 @@ void pic_init(void) {
     __asm__ volatile("movb $0x01, %al");      // ICW4: 8086模式
     __asm__ volatile("outb %al, $0xA1");      // 发送到从PIC
     
-    // 启用键盘中断 (IRQ1)
-    __asm__ volatile("movb $0xFD, %al");      // 只启用键盘中断
+    // 启用时钟中断 (IRQ0) 和键盘中断 (IRQ1)
+    __asm__ volatile("movb $0xFC, %al");      // 屏蔽其余中断
     __asm__ volatile("outb %al, $0x21");      // 发送到主PIC
 }
 
 // 初始化IDT
 void idt_init(void) {
-    // 初始化PIC
+    // 初始化PIC和时钟
     pic_init();
+    timer_init();
     
     // 设置IDT描述符
     idt_desc.limit = sizeof(idt) - 1;
@@ -74,7 +78,7 @@ void idt_init(void) {
     idt_set_entry(INT_SEGMENT_NOT_PRESENT, (uint32_t)segment_not_present_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
     idt_set_entry(INT_STACK_FAULT, (uint32_t)stack_fault_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
     idt_set_entry(INT_GENERAL_PROTECTION, (uint32_t)general_protection_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
-    idt_set_entry(INT_PAGE_FAULT, (uint32_t)page_fault_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
+    idt_set_entry(INT_PAGE_FAULT, (uint32_t)interrupt_handler_14, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
     idt_set_entry(INT_FPU_ERROR, (uint32_t)fpu_error_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
     idt_set_entry(INT_ALIGNMENT_CHECK, (uint32_t)alignment_check_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
     idt_set_entry(INT_MACHINE_CHECK, (uint32_t)machine_check_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_0 | IDT_ATTR_32BIT_INT);
@@ -204,10 +208,41 @@ void general_protection_handler(void) {
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 }
 
-void page_fault_handler(void) {
+void page_fault_handler(uint32_t error_code) {
+    uint32_t fault_addr;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(fault_addr));
+    
+    // 落在当前上下文的虚拟内存区域内：分配页面后重新执行故障指令
+    if (handle_page_fault(fault_addr, error_code)) {
+        return;
+    }
+    
+    // 无法处理的页故障，返回只会再次触发同一个故障
     vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-    vga_putstr("Exception: Page Fault!\n");
+    vga_putstr("Exception: Page Fault at 0x");
+    vga_puthex(fault_addr);
+    vga_putstr(" (error 0x");
+    vga_puthex(error_code);
+    vga_putstr(")\n");
+    
+    // 发生在普通进程中（无论访问的是用户空间还是内核地址）：只终止这个进程，
+    // process_kill终止当前进程时直接切换到下一个进程，不会返回
+    pcb_t* current = process_get_current();
+    if (current && current->pid != 0) {
+        vga_putstr("Killing process ");
+        vga_putstr(current->name);
+        vga_putstr(" (PID ");
+        vga_putnum((int)current->pid);
+        vga_putstr(")\n");
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        process_kill(current->pid);
+    }
+    
+    // 内核初始化或空闲进程（shell，运行在启动栈上，不能终止）中的故障无法恢复
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
 }
 
 void fpu_error_handler(void) {
@@ -234,18 +269,60 @@ void simd_fpu_error_handler(void) {
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 }
 
+// 启动以来的时钟中断次数
+static volatile uint32_t timer_ticks = 0;
+
+// 把PIT通道0编程为每秒TIMER_HZ次中断
+void timer_init(void) {
+    uint32_t divisor = PIT_FREQUENCY / TIMER_HZ;
+    
+    __asm__ volatile("outb %0, $0x43" : : "a"((uint8_t)0x36));           // 通道0，先低后高，模式3（方波）
+    __asm__ volatile("outb %0, $0x40" : : "a"((uint8_t)(divisor & 0xFF)));
+    __asm__ volatile("outb %0, $0x40" : : "a"((uint8_t)(divisor >> 8)));
+}
+
 // 中断处理程序实现
 void timer_handler(void) {
-    // 简单的定时器处理 - 不调用复杂函数
-    static int timer_count = 0;
-    timer_count++;
-    
-    // 只做简单的计数，不调用VGA函数
-    // 这样可以避免在中断中调用复杂函数导致的问题
+    timer_ticks++;
     
-    // 发送中断结束信号给PIC
+    // 先发送中断结束信号：调度器可能切换到别的进程，很久之后才回到这里
     __asm__ volatile("movb $0x20, %al");
     __asm__ volatile("outb %al, $0x20");
+    
+    // 时间片记账，用完时抢占当前进程
+    scheduler_tick();
+}
+
+// 获取启动以来的时钟中断次数
+uint32_t timer_get_ticks(void) {
+    return timer_ticks;
+}
+
+// 用PIT通道2校准TSC频率（kHz）：通道2不产生中断，门控由端口0x61控制，计数到0时输出变高
+uint32_t timer_tsc_khz(void) {
+    static uint32_t tsc_khz = 0;
+    if (tsc_khz) {
+        return tsc_khz;
+    }
+    
+    uint32_t latch = PIT_FREQUENCY / 100;    // 10ms
+    uint8_t gate;
+    
+    __asm__ volatile("inb $0x61, %0" : "=a"(gate));
+    gate = (gate & ~0x02) | 0x01;            // 打开通道2的门控，关闭扬声器
+    __asm__ volatile("outb %0, $0x61" : : "a"(gate));
+    
+    __asm__ volatile("outb %0, $0x43" : : "a"((uint8_t)0xB0));          // 通道2，先低后高，模式0
+    __asm__ volatile("outb %0, $0x42" : : "a"((uint8_t)(latch & 0xFF)));
+    __asm__ volatile("outb %0, $0x42" : : "a"((uint8_t)(latch >> 8)));
+    
+    uint32_t start = read_tsc();
+    do {
+        __asm__ volatile("inb $0x61, %0" : "=a"(gate));
+    } while (!(gate & 0x20));
+    
+    tsc_khz = (read_tsc() - start) / 10;
+    return tsc_khz;
 }
 
 void keyboard_handler(void) {
@@ -77,7 +77,7 @@ void invalid_tss_handler(void);
 void segment_not_present_handler(void);
 void stack_fault_handler(void);
 void general_protection_handler(void);
-void page_fault_handler(void);
+void page_fault_handler(uint32_t error_code);
 void fpu_error_handler(void);
 void alignment_check_handler(void);
 void machine_check_handler(void);
@@ -87,4 +87,38 @@ void simd_fpu_error_handler(void);
 void timer_handler(void);
 void keyboard_handler(void);
 
+// 时钟
+#ifndef TIMER_HZ
+#define TIMER_HZ 100                // 时钟中断频率，编译时用make HZ=<n>修改
+#endif
+#define PIT_FREQUENCY 1193182       // PIT输入时钟（Hz）
+#if TIMER_HZ < 19 || TIMER_HZ > 1000
+#error "TIMER_HZ must be between 19 and 1000 (PIT divisor is 16 bits)"
+#endif
+void timer_init(void);
+uint32_t timer_get_ticks(void);
+uint32_t timer_tsc_khz(void);
+
+// 关中断并返回之前的EFLAGS，与irq_restore配对使用，可以嵌套
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// 恢复irq_save之前的中断状态
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+// 读取时间戳计数器的低32位（用于测量短时间间隔）
+static inline uint32_t read_tsc(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    (void)high;
+    return low;
+}
+
 #endif
@@ -4,6 +4,9 @@
 #include "interrupt.h"
 #include "../drivers/keyboard/keyboard.h"
 #include "memory.h"
+#include "slab.h"
+#include "memprof.h"
+#include "swap.h"
 #include "../fs/filesystem.h"
 #include "process/process.h"
 #include "syscall.h"
@@ -20,7 +23,7 @@ typedef struct {
 } command_t;
 
 // Forward declarations
-void kmain(void);
+void kmain(const e820_map_t* boot_memory_map);
 void shell_init(void);
 void shell_run(void);
 void shell_prompt(void);
@@ -34,6 +37,10 @@ void shell_malloc(int argc, char* argv[]);
 void shell_free(int argc, char* argv[]);
 void shell_paging(int argc, char* argv[]);
 void shell_memmap(int argc, char* argv[]);
+void shell_slabinfo(int argc, char* argv[]);
+void shell_memprof(int argc, char* argv[]);
+void shell_swap(int argc, char* argv[]);
+void shell_ctxbench(int argc, char* argv[]);
 void shell_ls(int argc, char* argv[]);
 void shell_cat(int argc, char* argv[]);
 void shell_touch(int argc, char* argv[]);
@@ -46,15 +53,18 @@ void shell_fs_info(int argc, char* argv[]);
 void shell_ps(int argc, char* argv[]);
 void shell_kill(int argc, char* argv[]);
 void shell_priority(int argc, char* argv[]);
+void shell_spin(int argc, char* argv[]);
+void shell_sched(int argc, char* argv[]);
+void shell_schedbench(int argc, char* argv[]);
 void shell_syscall(int argc, char* argv[]);
 
 // Entry point for the kernel
 __attribute__((section(".text._start")))
-void _start(void) {
-    kmain();
+void _start(const e820_map_t* boot_memory_map) {
+    kmain(boot_memory_map);
 }
 
-void kmain(void) {
+void kmain(const e820_map_t* boot_memory_map) {
     // Initialize VGA display
     vga_init();
     
@@ -76,7 +86,7 @@ void kmain(void) {
     
     // Initialize memory management
     vga_putstr("Step 3: Initializing memory...\n");
-    memory_init();
+    memory_init(boot_memory_map);
     vga_putstr("Step 3: Memory initialized.\n");
     
     // Initialize filesystem
@@ -133,6 +143,10 @@ static command_t commands[] = {
     {"free", shell_free, "Free allocated memory (usage: free <address>)."},
     {"paging", shell_paging, "Show paging information."},
     {"memmap", shell_memmap, "Show memory map."},
+    {"slabinfo", shell_slabinfo, "Show slab object caches."},
+    {"memprof", shell_memprof, "Show kernel allocations by call site."},
+    {"swap", shell_swap, "Show swap device usage."},
+    {"ctxbench", shell_ctxbench, "Measure kernel thread context switch rate."},
     {"ls", shell_ls, "List directory contents."},
     {"cat", shell_cat, "Display file contents (usage: cat <filename>)."},
     {"touch", shell_touch, "Create empty file (usage: touch <filename>)."},
@@ -145,6 +159,9 @@ static command_t commands[] = {
     {"ps", shell_ps, "List all processes."},
     {"kill", shell_kill, "Kill a process (usage: kill <pid>)."},
     {"priority", shell_priority, "Set process priority (usage: priority <pid> <level>)."},
+    {"spin", shell_spin, "Start a CPU-bound thread (usage: spin [level])."},
+    {"sched", shell_sched, "Show or set scheduler policy (usage: sched [policy])."},
+    {"schedbench", shell_schedbench, "Measure CPU shares of LOW/NORMAL/HIGH spinners."},
     {"syscall", shell_syscall, "System call interface (usage: syscall <num> [args...])."},
     {"", NULL, ""} // End marker
 };
@@ -248,7 +265,8 @@ void shell_read_input(char* buffer, int max_length) {
                 vga_putchar(ch);
             }
             // Ignore other control characters
-        } else {
+        } else if (!process_idle()) {
+            // Nothing left to pre-zero, sleep until the next interrupt
             __asm__ volatile("hlt");
         }
     }
@@ -465,6 +483,61 @@ void shell_memmap(int argc, char* argv[]) {
     print_memory_map();
 }
 
+// slabinfo command
+void shell_slabinfo(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    kmem_print_info();
+}
+
+// memprof command
+void shell_memprof(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    memprof_print();
+}
+
+// swap command
+void shell_swap(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    print_swap_info();
+}
+
+// ctxbench command
+void shell_ctxbench(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    uint32_t switches, cycles;
+    int result = process_switch_benchmark(SWITCH_BENCH_ROUNDS, &switches, &cycles);
+    if (result != PROCESS_SUCCESS || switches == 0) {
+        vga_putstr("Context switch benchmark failed: ");
+        vga_putnum(result);
+        vga_putstr("\n");
+        return;
+    }
+    
+    uint32_t cycles_per_switch = cycles / switches;
+    uint32_t tsc_khz = timer_tsc_khz();
+    
+    vga_putstr("Context switches: ");
+    vga_putnum(switches);
+    vga_putstr("\nCycles per switch: ");
+    vga_putnum(cycles_per_switch);
+    vga_putstr("\nTSC: ");
+    vga_putnum(tsc_khz / 1000);
+    vga_putstr(" MHz\n");
+    if (cycles_per_switch && tsc_khz) {
+        vga_putstr("Switches per second: ");
+        vga_putnum((tsc_khz / cycles_per_switch) * 1000);
+        vga_putstr("\n");
+    }
+}
+
 // ls command
 void shell_ls(int argc, char* argv[]) {
     (void)argc;
@@ -722,8 +795,8 @@ void shell_ps(int argc, char* argv[]) {
     }
     
     print_info("Process List:\n");
-    vga_putstr("PID | Name                | State     | Priority  | CPU Time\n");
-    vga_putstr("----|---------------------|-----------|-----------|---------\n");
+    vga_putstr("PID | Name                | State     | Priority  | Level     | CPU Time\n");
+    vga_putstr("----|---------------------|-----------|-----------|-----------|---------\n");
     
     for (uint32_t i = 0; i < count; i++) {
         vga_putstr(" ");
@@ -756,6 +829,14 @@ void shell_ps(int argc, char* argv[]) {
         }
         vga_putstr(" | ");
         
+        // 打印当前调度级别（MLFQ下会低于优先级）
+        const char* level = process_priority_to_string(processes[i].level);
+        vga_putstr(level);
+        for (int j = strlen(level); j < 9; j++) {
+            vga_putstr(" ");
+        }
+        vga_putstr(" | ");
+        
         // 打印CPU时间
         vga_puthex(processes[i].cpu_time);
         vga_putstr("\n");
@@ -845,6 +926,144 @@ void shell_priority(int argc, char* argv[]) {
     }
 }
 
+// CPU-bound thread started by the spin command: never yields, only the timer can take the CPU away
+static void spin_thread(void) {
+    volatile uint32_t counter = 0;
+    for (;;) {
+        counter++;
+    }
+}
+
+// sched command
+void shell_sched(int argc, char* argv[]) {
+    if (argc >= 2) {
+        uint32_t policy = 0;
+        while (policy < SCHED_POLICY_COUNT &&
+               strcmp(argv[1], scheduler_policy_name((sched_policy_t)policy)) != 0) {
+            policy++;
+        }
+        if (policy == SCHED_POLICY_COUNT) {
+            print_error("Unknown policy (priority, mlfq, fair)\n");
+            return;
+        }
+        process_set_policy((sched_policy_t)policy);
+    }
+    
+    process_manager_t stats;
+    process_get_stats(&stats);
+    
+    vga_putstr("Scheduler policy: ");
+    vga_putstr(scheduler_policy_name(scheduler_get_policy()));
+    vga_putstr("\nTimer: ");
+    vga_putnum(TIMER_HZ);
+    vga_putstr(" Hz, base time slice ");
+    vga_putnum(stats.time_slice_quantum);
+    vga_putstr(" ticks\nContext switches: ");
+    vga_putnum(stats.context_switches);
+    vga_putstr("\n");
+}
+
+// schedbench command - run one spinner per priority and report the CPU share each one got
+void shell_schedbench(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    static const process_priority_t levels[SCHED_BENCH_WORKERS] = {
+        PROCESS_PRIORITY_LOW, PROCESS_PRIORITY_NORMAL, PROCESS_PRIORITY_HIGH
+    };
+    int pids[SCHED_BENCH_WORKERS];
+    uint32_t ticks[SCHED_BENCH_WORKERS];
+    
+    // shell临时提到最高优先级，在严格优先级策略下也能按时结束测试
+    pcb_t* shell = process_get_current();
+    process_priority_t shell_priority = shell->priority;
+    process_set_priority(shell->pid, PROCESS_PRIORITY_CRITICAL);
+    
+    for (int i = 0; i < SCHED_BENCH_WORKERS; i++) {
+        pids[i] = process_create("bench", (void*)spin_thread, levels[i], 0);
+        if (pids[i] < 0) {
+            print_error("Failed to create benchmark thread\n");
+            while (i-- > 0) {
+                process_kill(pids[i]);
+            }
+            process_set_priority(shell->pid, shell_priority);
+            return;
+        }
+    }
+    
+    process_manager_t before, after;
+    process_get_stats(&before);
+    uint32_t start = timer_get_ticks();
+    while (timer_get_ticks() - start < SCHED_BENCH_SECONDS * TIMER_HZ) {
+        process_yield();
+    }
+    process_get_stats(&after);
+    
+    uint32_t total = 0;
+    for (int i = 0; i < SCHED_BENCH_WORKERS; i++) {
+        pcb_t info;
+        ticks[i] = 0;
+        if (process_get_info(pids[i], &info) == PROCESS_SUCCESS) {
+            ticks[i] = info.cpu_time;
+        }
+        total += ticks[i];
+        process_kill(pids[i]);
+    }
+    process_set_priority(shell->pid, shell_priority);
+    
+    vga_putstr("Policy: ");
+    vga_putstr(scheduler_policy_name(scheduler_get_policy()));
+    vga_putstr(", ");
+    vga_putnum(SCHED_BENCH_SECONDS);
+    vga_putstr(" s\n");
+    for (int i = 0; i < SCHED_BENCH_WORKERS; i++) {
+        vga_putstr("  ");
+        vga_putstr(process_priority_to_string(levels[i]));
+        vga_putstr(": ");
+        vga_putnum(ticks[i]);
+        vga_putstr(" ticks (");
+        vga_putnum(total ? ticks[i] * 100 / total : 0);
+        vga_putstr("%)\n");
+    }
+    vga_putstr("Worker ticks: ");
+    vga_putnum(total);
+    vga_putstr(" of ");
+    vga_putnum(SCHED_BENCH_SECONDS * TIMER_HZ);
+    vga_putstr(", context switches: ");
+    vga_putnum(after.context_switches - before.context_switches);
+    vga_putstr("\n");
+}
+
+// spin command
+void shell_spin(int argc, char* argv[]) {
+    uint32_t priority_level = PROCESS_PRIORITY_NORMAL;
+    if (argc >= 2) {
+        priority_level = 0;
+        for (int i = 0; argv[1][i] != '\0'; i++) {
+            if (argv[1][i] >= '0' && argv[1][i] <= '9') {
+                priority_level = priority_level * 10 + (argv[1][i] - '0');
+            } else {
+                print_error("Invalid priority level format\n");
+                return;
+            }
+        }
+        if (priority_level < 1 || priority_level > 4) {
+            print_error("Priority level must be 1-4\n");
+            return;
+        }
+    }
+    
+    int pid = process_create("spin", (void*)spin_thread, (process_priority_t)priority_level, 0);
+    if (pid < 0) {
+        print_error("Failed to create spin thread\n");
+        return;
+    }
+    
+    print_success("Started spin thread, PID ");
+    vga_putnum(pid);
+    vga_putstr("\n");
+}
+
 // syscall command - system call interface
 void shell_syscall(int argc, char* argv[]) {
     if (argc < 2) {
@@ -1,41 +1,160 @@
 #include "memory.h"
+#include "slab.h"
 #include "../drivers/vga/vga.h"
 #include "../lib/string.h"
 #include "interrupt.h"
+#include "memprof.h"
+#include "swap.h"
+
+// 物理内存布局
+#define PHYS_METADATA_START 0x500000       // 位图和页帧描述符数组从5MB开始依次存放
+#define PHYS_MAX_MEMORY USER_SPACE_START   // 物理内存全部身份映射在用户空间之下，最多管理3GB
+#define DEFAULT_MEMORY_SIZE 0x4000000      // 没有E820信息时保守地假设64MB（QEMU默认128MB）
+#define BUDDY_ORDER_NONE 0xFF              // 页帧不是空闲块的头部
+#define PAGE_TABLE_POOL_MAX 64             // 回收池最多缓存的页表页帧，多余的还给伙伴系统
+#define ZERO_PAGE_POOL_MAX 32              // 空闲进程最多预先清零的页帧数
+#define HEAP_GROW_MIN 0x10000              // 堆每次至少增长64KB，摊薄映射开销
+#define HEAP_SHRINK_THRESHOLD 0x40000      // 末尾空闲超过256KB时才收缩
+
+// 堆的两级分离空闲链表（TLSF）
+#define TLSF_SL_LOG2 4                     // 每个一级区间再分16个二级区间
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_SMALL_BLOCK 128               // 小于此值的块按8字节线性分级
+#define TLSF_FL_SHIFT 7                    // log2(TLSF_SMALL_BLOCK)
+#define TLSF_FL_COUNT 26                   // 覆盖到2GB的块
+
+// 空闲块链表节点（直接存放在空闲页帧中）
+typedef struct buddy_block {
+    struct buddy_block* next;
+    struct buddy_block* prev;
+} buddy_block_t;
 
 // 全局变量
 static page_directory_t* current_page_directory = NULL;
-static memory_block_t* memory_map = NULL;
+static page_directory_t* kernel_page_directory = NULL;
+static memory_context_t* current_memory_context = NULL;
+static memory_block_t* heap_free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static uint32_t heap_fl_bitmap = 0;
+static uint32_t heap_sl_bitmap[TLSF_FL_COUNT];
 static memory_stats_t memory_stats = {0};
 static uint32_t* physical_page_bitmap = NULL;
 static uint32_t bitmap_size = 0;
+static uint32_t total_pages = 0;
+static uint32_t phys_reserved_end = 0;     // 内核、堆与分配器元数据占用的低端内存
+static buddy_block_t* buddy_free_lists[ZONE_COUNT][BUDDY_MAX_ORDER + 1]; // 每个区域独立的空闲链表
+static uint32_t buddy_free_blocks[BUDDY_MAX_ORDER + 1];
+static uint32_t buddy_free_pages = 0;
+static uint32_t zone_free_pages[ZONE_COUNT];
+static page_t* page_descriptors = NULL;    // 页帧描述符数组，按页帧号索引
 static uint32_t heap_start = 0;
 static uint32_t heap_end = 0;
 static uint32_t heap_current = 0;
+static kmem_cache_t* memory_context_cache = NULL;
+static kmem_cache_t* vm_area_cache = NULL;
+static kmem_cache_t* vmalloc_area_cache = NULL;
+static vmalloc_area_t* vmalloc_areas = NULL; // 已分配的vmalloc区域，按地址排序
+static bool pse_enabled = false;           // CPU支持并已开启4MB大页
+static buddy_block_t* page_table_pool = NULL; // 回收的页表页帧（单链表，复用空闲块节点）
+static buddy_block_t* zero_page_pool = NULL;  // 已清零的页帧（只有首个字保存链表指针）
+static page_t* lru_lists[LRU_COUNT];       // 活跃/非活跃链表（循环双向链表，头部最近使用）
+static uint32_t watermark_min = 0;         // 空闲页低于此值时分配路径同步回收
+static uint32_t watermark_low = 0;         // 低于此值时空闲进程开始后台回收
+static uint32_t watermark_high = 0;        // 后台回收的目标
+static bool reclaim_running = false;       // 回收路径中再次分配页帧时不递归回收
 
 // 内部函数声明
 static void setup_identity_paging(void);
 static void setup_kernel_paging(void);
+static page_entry_t* get_page_entry(page_directory_t* pd, uint32_t virtual_addr, bool create);
+static bool map_page_in(page_directory_t* pd, uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags);
+static void map_linear_range(uint32_t start, uint32_t end, uint32_t flags);
+static void reserve_kernel_page_tables(uint32_t start, uint32_t end);
+static bool map_kernel_pages(uint32_t start, uint32_t end);
+static void unmap_kernel_pages(uint32_t start, uint32_t end);
+static bool map_user_page(memory_context_t* ctx, uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags);
+static void release_page_tables(memory_context_t* ctx);
+static vm_area_t* find_vm_area(memory_context_t* ctx, uint32_t addr);
+static void release_user_pages(memory_context_t* ctx, uint32_t start, uint32_t end);
+static vm_area_t* alloc_vm_area(uint32_t start, uint32_t end, uint32_t flags,
+                                fs_file_t* file, uint32_t file_offset);
+static void free_vm_area(vm_area_t* area);
+static bool insert_vm_area(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                           fs_file_t* file, uint32_t file_offset);
+static vm_area_t* find_split_area(memory_context_t* ctx, uint32_t start, uint32_t end);
+static void remove_vm_range(memory_context_t* ctx, uint32_t start, uint32_t end, vm_area_t* tail);
+static void fill_file_page(vm_area_t* area, uint32_t page_addr, uint32_t page);
+static void install_user_page(memory_context_t* ctx, uint32_t virtual_addr, uint32_t page);
+static void put_user_page(memory_context_t* ctx, uint32_t page);
+static void lru_add(page_t* desc, uint32_t list);
+static void lru_del(page_t* desc);
+static page_entry_t* page_mapping_entry(page_t* desc);
+static bool try_reclaim_page(page_t* desc, page_entry_t* entry);
+static bool is_swap_entry(const page_entry_t* entry);
+static bool swap_in_page(memory_context_t* ctx, vm_area_t* area, uint32_t page_addr, page_entry_t* entry);
+static uint32_t shrink_lru_list(uint32_t list, uint32_t nr_to_scan, uint32_t target);
+static uint32_t drain_page_table_pool(void);
+static uint32_t alloc_page_or_reclaim(void);
+static bool handle_cow_fault(memory_context_t* ctx, uint32_t fault_addr);
 static memory_block_t* find_free_block(size_t size);
-static memory_block_t* split_block(memory_block_t* block, size_t size);
-static void merge_adjacent_blocks(void);
-static void update_memory_stats(void);
-static void init_physical_page_bitmap(void);
-static uint32_t find_free_physical_page(void);
+static void split_block(memory_block_t* block, size_t size);
+static memory_block_t* coalesce_block(memory_block_t* block);
+static memory_block_t* heap_grow_for(uint32_t block_size);
+static void heap_trim(memory_block_t* block);
+static void set_block(memory_block_t* block, uint32_t size, memory_type_t type);
+static memory_block_t* next_physical_block(memory_block_t* block);
+static void heap_insert_free(memory_block_t* block);
+static void heap_remove_free(memory_block_t* block);
+static void tlsf_mapping(uint32_t size, uint32_t* fl, uint32_t* sl);
+static uint32_t heap_block_size(size_t size);
+static bool is_heap_pointer(void* ptr);
+static uint32_t memory_size_class(uint32_t size);
+static void account_alloc(uint32_t size);
+static void account_free(uint32_t size);
+static void* kmalloc_tracked(size_t size, uint32_t caller);
+static void* kmalloc_nolock(size_t size, uint32_t caller);
+static void* kmalloc_aligned_nolock(size_t size, size_t align, uint32_t caller);
+static void kfree_nolock(void* ptr);
+static void* krealloc_nolock(void* ptr, size_t size, uint32_t caller);
+static void free_pages_nolock(uint32_t page, uint32_t order);
+static void profile_alloc(void* ptr, uint32_t size, uint32_t caller);
+static void profile_free(void* ptr, uint32_t size);
+static void detect_physical_memory(const e820_map_t* map);
+static bool e820_usable_range(const e820_entry_t* entry, uint32_t* start, uint32_t* end);
+static void init_physical_page_bitmap(const e820_map_t* map);
+static void init_buddy_allocator(void);
+static void buddy_push(uint32_t pfn, uint32_t order);
+static void buddy_remove(uint32_t pfn, uint32_t order);
+static void buddy_add_range(uint32_t start_pfn, uint32_t end_pfn);
+static uint32_t buddy_alloc_from(uint32_t zone, uint32_t order);
+static uint32_t page_zone(uint32_t pfn);
+static void set_bitmap_range(uint32_t pfn, uint32_t count, bool set);
 static void set_bitmap_bit(uint32_t page, bool set);
 static bool get_bitmap_bit(uint32_t page);
 
 // 初始化内存管理系统
-void memory_init(void) {
+void memory_init(const e820_map_t* map) {
     vga_putstr("Initializing memory management...\n");
     
     // 初始化内存统计
     memset(&memory_stats, 0, sizeof(memory_stats_t));
-    memory_stats.total_memory = 0x10000000; // 假设256MB内存
-    memory_stats.free_memory = memory_stats.total_memory;
+    memory_stats.free_memory = 0;           // 由伙伴系统建立空闲链表时累加
+    
+    // 根据E820内存图确定物理内存大小
+    detect_physical_memory(map);
     
     // 初始化物理页面位图
-    init_physical_page_bitmap();
+    init_physical_page_bitmap(map);
+    
+    // 根据位图建立伙伴系统空闲链表
+    init_buddy_allocator();
+    
+    // 回收水位按可用内存的比例设定
+    watermark_min = buddy_free_pages / 128;
+    if (watermark_min < WATERMARK_MIN_PAGES) {
+        watermark_min = WATERMARK_MIN_PAGES;
+    }
+    watermark_low = watermark_min * 2;
+    watermark_high = watermark_min * 3;
     
     // 初始化分页
     paging_init();
@@ -43,6 +162,17 @@ void memory_init(void) {
     // 初始化堆
     heap_init();
     
+    // 初始化slab分配器和常用对象缓存
+    kmem_init();
+    memory_context_cache = kmem_cache_create("mm_context", sizeof(memory_context_t), 0, NULL);
+    vm_area_cache = kmem_cache_create("vm_area", sizeof(vm_area_t), 0, NULL);
+    
+    // 建立vmalloc区域
+    vmalloc_init();
+    
+    // 启用交换区
+    swap_init();
+    
     vga_putstr("Memory management initialized successfully!\n");
 }
 
@@ -50,48 +180,65 @@ void memory_init(void) {
 void paging_init(void) {
     vga_putstr("Setting up paging...\n");
     
-    // 使用更安全的内存地址
-    current_page_directory = (page_directory_t*)0x1000000; // 使用16MB处的内存
+    // 内核页目录和其他页帧一样来自伙伴系统
+    kernel_page_directory = (page_directory_t*)alloc_zeroed_page();
+    current_page_directory = kernel_page_directory;
+    current_memory_context = NULL;
     
-    // 清零页目录
-    memset(current_page_directory, 0, sizeof(page_directory_t));
+    // CPU支持时用4MB页目录项建立内核映射，省去页表并减少TLB占用
+    if (cpu_has_pse_asm()) {
+        enable_pse_asm();
+        pse_enabled = true;
+        vga_putstr("PSE 4MB pages enabled\n");
+    }
     
-    // 设置身份映射（前4MB）
+    // 设置身份映射（全部物理内存）
     setup_identity_paging();
     
     // 设置内核分页
     setup_kernel_paging();
     
-    // 暂时不启用分页，避免地址映射问题
-    // enable_paging();
+    // 内核始终通过身份映射访问物理内存，开启分页不改变任何内核地址
+    enable_paging();
     
-    vga_putstr("Paging setup completed (not enabled)\n");
+    vga_putstr("Paging enabled\n");
 }
 
 // 设置身份映射
 static void setup_identity_paging(void) {
-    // 为前4MB创建身份映射
-    for (uint32_t i = 0; i < 1024; i++) {
-        uint32_t physical_addr = i * PAGE_SIZE;
-        uint32_t virtual_addr = physical_addr;
-        
-        map_page(virtual_addr, physical_addr, 
-                PAGE_PRESENT | PAGE_WRITABLE | PAGE_GLOBAL);
-    }
+    // 为全部物理内存创建身份映射（仅内核可访问），页帧、页表和堆都直接用物理地址访问
+    map_linear_range(0, total_pages * PAGE_SIZE,
+                     PAGE_PRESENT | PAGE_WRITABLE | PAGE_GLOBAL);
 }
 
 // 设置内核分页
 static void setup_kernel_paging(void) {
     // 映射内核代码和数据段
-    uint32_t kernel_start = 0x100000;  // 1MB
-    uint32_t kernel_size = 0x100000;   // 1MB
+    uint32_t kernel_start = KERNEL_START;  // 1MB
+    uint32_t kernel_size = 0x100000;       // 1MB
+    
+    map_linear_range(kernel_start, kernel_start + kernel_size,
+                     PAGE_PRESENT | PAGE_WRITABLE);
+}
+
+// 身份映射[start, end)：开启PSE时每个4MB整块只占一个页目录项，否则逐页映射
+static void map_linear_range(uint32_t start, uint32_t end, uint32_t flags) {
+    uint32_t addr = start & ~(PAGE_SIZE - 1);
     
-    for (uint32_t i = 0; i < kernel_size / PAGE_SIZE; i++) {
-        uint32_t physical_addr = kernel_start + (i * PAGE_SIZE);
-        uint32_t virtual_addr = physical_addr;
+    while (addr < end) {
+        if (pse_enabled) {
+            // 大页只能整块覆盖，首尾没有对齐时扩展到所在的4MB边界（身份映射，多出的部分无害）
+            uint32_t large_start = addr & ~(LARGE_PAGE_SIZE - 1);
+            map_large_page(large_start, large_start, flags);
+            addr = large_start + LARGE_PAGE_SIZE;
+            if (addr == 0) {
+                break; // 地址回绕
+            }
+            continue;
+        }
         
-        map_page(virtual_addr, physical_addr,
-                PAGE_PRESENT | PAGE_WRITABLE);
+        map_page(addr, addr, flags);
+        addr += PAGE_SIZE;
     }
 }
 
@@ -101,74 +248,370 @@ void heap_init(void) {
     heap_end = heap_start + KERNEL_HEAP_SIZE;
     heap_current = heap_start;
     
-    // 创建初始内存块
+    memset(heap_free_lists, 0, sizeof(heap_free_lists));
+    memset(heap_sl_bitmap, 0, sizeof(heap_sl_bitmap));
+    heap_fl_bitmap = 0;
+    
+    // 整个增长窗口的页表先建好，之后增长时映射的页面对所有上下文可见
+    reserve_kernel_page_tables(heap_start, heap_start + KERNEL_HEAP_MAX_SIZE);
+    if (!map_kernel_pages(heap_start, heap_end)) {
+        vga_putstr("Heap: out of memory\n");
+        return;
+    }
+    memory_stats.heap_size = KERNEL_HEAP_SIZE;
+    
+    // 创建初始空闲块，末尾留出一个大小为0的已分配哨兵块
     memory_block_t* initial_block = (memory_block_t*)heap_start;
-    initial_block->start_addr = heap_start + sizeof(memory_block_t);
-    initial_block->size = KERNEL_HEAP_SIZE - sizeof(memory_block_t);
-    initial_block->type = MEMORY_FREE;
-    initial_block->next = NULL;
-    initial_block->prev = NULL;
+    set_block(initial_block, KERNEL_HEAP_SIZE - HEAP_BLOCK_HEADER_SIZE, MEMORY_FREE);
+    heap_insert_free(initial_block);
     
-    memory_map = initial_block;
+    memory_block_t* epilogue = next_physical_block(initial_block);
+    epilogue->size = 0;
+    epilogue->type = MEMORY_ALLOCATED;
     
     vga_putstr("Heap initialized at 0x");
     vga_puthex(heap_start);
     vga_putstr("\n");
 }
 
+// 取E820区域中可用的部分：按页向内对齐，并截断到可管理的范围
+static bool e820_usable_range(const e820_entry_t* entry, uint32_t* start, uint32_t* end) {
+    if (entry->type != E820_TYPE_USABLE || entry->base >= PHYS_MAX_MEMORY) {
+        return false;
+    }
+    
+    uint64_t limit = entry->base + entry->length;
+    if (limit > PHYS_MAX_MEMORY) {
+        limit = PHYS_MAX_MEMORY;
+    }
+    
+    *start = align_to_page((uint32_t)entry->base);
+    *end = (uint32_t)limit & ~(PAGE_SIZE - 1);
+    return *start < *end;
+}
+
+// 统计可用内存并确定需要管理的页帧数（到最高的可用地址为止）
+static void detect_physical_memory(const e820_map_t* map) {
+    uint32_t top = 0;
+    
+    memory_stats.total_memory = 0;
+    for (uint32_t i = 0; map && i < map->count && i < E820_MAX_ENTRIES; i++) {
+        uint32_t start, end;
+        if (!e820_usable_range(&map->entries[i], &start, &end)) {
+            continue;
+        }
+        
+        memory_stats.total_memory += end - start;
+        if (end > top) {
+            top = end;
+        }
+    }
+    
+    // BIOS不支持E820时退回旧的假设
+    if (top == 0) {
+        vga_putstr("No E820 memory map, assuming ");
+        vga_putnum(DEFAULT_MEMORY_SIZE / (1024 * 1024));
+        vga_putstr("MB\n");
+        top = DEFAULT_MEMORY_SIZE;
+        memory_stats.total_memory = DEFAULT_MEMORY_SIZE;
+    }
+    
+    total_pages = top / PAGE_SIZE;
+}
+
 // 初始化物理页面位图
-static void init_physical_page_bitmap(void) {
-    // 计算需要的位图大小（假设最大256MB内存）
-    uint32_t max_pages = 0x10000000 / PAGE_SIZE; // 256MB / 4KB
-    bitmap_size = (max_pages + 31) / 32; // 每个uint32_t包含32位
+static void init_physical_page_bitmap(const e820_map_t* map) {
+    bitmap_size = (total_pages + 31) / 32; // 每个uint32_t包含32位
+    
+    // 位图和页帧描述符数组按实际页帧数依次排在5MB之后
+    uint32_t metadata = PHYS_METADATA_START;
+    physical_page_bitmap = (uint32_t*)metadata;
+    metadata += align_to_page(bitmap_size * sizeof(uint32_t));
+    page_descriptors = (page_t*)metadata;
+    metadata += align_to_page(total_pages * sizeof(page_t));
+    phys_reserved_end = metadata;
+    
+    // 先把所有页帧标记为不可用，再放开E820报告的可用区域，空洞和保留区永远不会交给分配器
+    memset(physical_page_bitmap, 0xFF, bitmap_size * sizeof(uint32_t));
+    bool has_map = false;
+    for (uint32_t i = 0; map && i < map->count && i < E820_MAX_ENTRIES; i++) {
+        uint32_t start, end;
+        if (e820_usable_range(&map->entries[i], &start, &end)) {
+            set_bitmap_range(start / PAGE_SIZE, (end - start) / PAGE_SIZE, false);
+            has_map = true;
+        }
+    }
+    if (!has_map) {
+        set_bitmap_range(0, total_pages, false);
+    }
+    
+    // 标记内核、堆与分配器元数据占用的低端内存
+    set_bitmap_range(0, phys_reserved_end / PAGE_SIZE, true);
+}
+
+// 初始化伙伴系统
+static void init_buddy_allocator(void) {
+    // 位图中此时仍被占用的页帧都是保留的，之后也不会交给分配器
+    memset(page_descriptors, 0, total_pages * sizeof(page_t));
+    for (uint32_t pfn = 0; pfn < total_pages; pfn++) {
+        page_descriptors[pfn].order = BUDDY_ORDER_NONE;
+        if (get_bitmap_bit(pfn)) {
+            page_descriptors[pfn].flags = PG_RESERVED;
+        }
+    }
+    
+    memset(buddy_free_lists, 0, sizeof(buddy_free_lists));
+    memset(buddy_free_blocks, 0, sizeof(buddy_free_blocks));
+    memset(zone_free_pages, 0, sizeof(zone_free_pages));
+    buddy_free_pages = 0;
+    
+    // 把位图中每段连续的空闲页帧切成尽量大的对齐块
+    uint32_t pfn = 0;
+    while (pfn < total_pages) {
+        if (get_bitmap_bit(pfn)) {
+            pfn++;
+            continue;
+        }
+        
+        uint32_t run_start = pfn;
+        while (pfn < total_pages && !get_bitmap_bit(pfn)) {
+            pfn++;
+        }
+        buddy_add_range(run_start, pfn);
+    }
+}
+
+// 将[start_pfn, end_pfn)按对齐的最大块加入空闲链表
+static void buddy_add_range(uint32_t start_pfn, uint32_t end_pfn) {
+    while (start_pfn < end_pfn) {
+        uint32_t order = BUDDY_MAX_ORDER;
+        while (order > 0 &&
+               ((start_pfn & ((1U << order) - 1)) || start_pfn + (1U << order) > end_pfn)) {
+            order--;
+        }
+        
+        buddy_push(start_pfn, order);
+        start_pfn += 1U << order;
+    }
+}
+
+// 页帧所属的区域（最大的块是4MB对齐的，不会跨越16MB边界）
+static uint32_t page_zone(uint32_t pfn) {
+    return pfn < ZONE_DMA_LIMIT / PAGE_SIZE ? ZONE_DMA : ZONE_NORMAL;
+}
+
+// 把空闲块插入所属区域对应阶的链表头
+static void buddy_push(uint32_t pfn, uint32_t order) {
+    buddy_block_t* block = (buddy_block_t*)(pfn * PAGE_SIZE);
+    uint32_t zone = page_zone(pfn);
     
-    // 分配位图内存
-    physical_page_bitmap = (uint32_t*)0x500000; // 在5MB处分配位图
+    block->prev = NULL;
+    block->next = buddy_free_lists[zone][order];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    buddy_free_lists[zone][order] = block;
+    
+    page_descriptors[pfn].order = (uint8_t)order;
+    buddy_free_blocks[order]++;
+    buddy_free_pages += 1U << order;
+    zone_free_pages[zone] += 1U << order;
+    memory_stats.free_memory += PAGE_SIZE << order;
+}
+
+// 从对应阶的链表中摘除空闲块
+static void buddy_remove(uint32_t pfn, uint32_t order) {
+    buddy_block_t* block = (buddy_block_t*)(pfn * PAGE_SIZE);
+    uint32_t zone = page_zone(pfn);
+    
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        buddy_free_lists[zone][order] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    
+    page_descriptors[pfn].order = BUDDY_ORDER_NONE;
+    buddy_free_blocks[order]--;
+    buddy_free_pages -= 1U << order;
+    zone_free_pages[zone] -= 1U << order;
+    memory_stats.free_memory -= PAGE_SIZE << order;
+}
+
+// 分配2^order个物理连续的页面，优先使用普通区域，保留DMA区域给需要它的驱动
+uint32_t alloc_physical_pages(uint32_t order) {
+    return alloc_pages_zone(order, ZONE_NORMAL);
+}
+
+// 在zone及更低的区域中分配2^order个页面；ZONE_DMA保证页面位于16MB以下
+// 不超过64KB的块按自身大小对齐，不会跨越ISA DMA的64KB边界
+uint32_t alloc_pages_zone(uint32_t order, uint32_t zone) {
+    if (order > BUDDY_MAX_ORDER || zone >= ZONE_COUNT) {
+        return 0;
+    }
+    
+    uint32_t flags = irq_save();
+    uint32_t page = 0;
+    for (uint32_t z = zone + 1; z-- > 0 && !page;) {
+        page = buddy_alloc_from(z, order);
+    }
+    irq_restore(flags);
+    return page;
+}
+
+// 从指定区域的空闲链表中分配
+static uint32_t buddy_alloc_from(uint32_t zone, uint32_t order) {
+    // 找到不小于所需阶的最小非空链表
+    uint32_t current = order;
+    while (current <= BUDDY_MAX_ORDER && !buddy_free_lists[zone][current]) {
+        current++;
+    }
+    if (current > BUDDY_MAX_ORDER) {
+        return 0; // 没有足够大的空闲块
+    }
+    
+    uint32_t pfn = (uint32_t)buddy_free_lists[zone][current] / PAGE_SIZE;
+    buddy_remove(pfn, current);
+    
+    // 逐级拆分，把高地址的一半放回低一阶的链表
+    while (current > order) {
+        current--;
+        buddy_push(pfn + (1U << current), current);
+    }
+    
+    set_bitmap_range(pfn, 1U << order, true);
+    memory_stats.page_allocations += 1U << order;
+    
+    return pfn * PAGE_SIZE;
+}
+
+// 释放2^order个页面，并与空闲的伙伴逐级合并
+void free_physical_pages(uint32_t page, uint32_t order) {
+    uint32_t flags = irq_save();
+    free_pages_nolock(page, order);
+    irq_restore(flags);
+}
+
+static void free_pages_nolock(uint32_t page, uint32_t order) {
+    uint32_t pfn = page / PAGE_SIZE;
+    
+    if (order > BUDDY_MAX_ORDER || pfn + (1U << order) > total_pages ||
+        (pfn & ((1U << order) - 1))) {
+        return;
+    }
+    
+    // 位图中未标记为已分配，说明是重复释放
+    if (!get_bitmap_bit(pfn)) {
+        return;
+    }
     
-    // 清零位图
-    memset(physical_page_bitmap, 0, bitmap_size * sizeof(uint32_t));
+    set_bitmap_range(pfn, 1U << order, false);
+    memory_stats.page_deallocations += 1U << order;
+    
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy = pfn ^ (1U << order);
+        if (buddy >= total_pages || page_descriptors[buddy].order != order) {
+            break;
+        }
+        
+        buddy_remove(buddy, order);
+        pfn &= ~(1U << order);
+        order++;
+    }
     
-    // 标记已使用的页面（前6MB）
-    uint32_t used_pages = 0x600000 / PAGE_SIZE;
-    for (uint32_t i = 0; i < used_pages; i++) {
-        set_bitmap_bit(i, true);
+    buddy_push(pfn, order);
+}
+
+// 分配单个页帧；空闲页低于min水位时先同步回收一批
+static uint32_t alloc_page_or_reclaim(void) {
+    if (buddy_free_pages < watermark_min) {
+        memory_stats.direct_reclaims++;
+        reclaim_pages(watermark_low - buddy_free_pages);
     }
+    return alloc_physical_pages(0);
 }
 
-// 分配物理页面
+// 分配物理页面，回收后仍然不足时返回0（页帧0永远是保留的）
 uint32_t alloc_physical_page(void) {
-    uint32_t page = find_free_physical_page();
-    if (page != 0) {
-        set_bitmap_bit(page, true);
-        memory_stats.page_allocations++;
-        update_memory_stats();
+    uint32_t page = alloc_page_or_reclaim();
+    
+    // 伙伴系统耗尽时取回预清零池中的页帧
+    uint32_t flags = irq_save();
+    if (!page && zero_page_pool) {
+        page = (uint32_t)zero_page_pool;
+        zero_page_pool = zero_page_pool->next;
+        phys_to_page(page)->flags &= ~PG_ZEROED;
+        memory_stats.zero_pool_pages--;
+    }
+    irq_restore(flags);
+    return page;
+}
+
+// 分配一个内容全为0的页面：优先从预清零池取，池空时同步清零
+uint32_t alloc_zeroed_page(void) {
+    uint32_t flags = irq_save();
+    if (zero_page_pool) {
+        buddy_block_t* node = zero_page_pool;
+        zero_page_pool = node->next;
+        node->next = NULL;               // 链表指针是页中唯一的非零内容
+        phys_to_page((uint32_t)node)->flags &= ~PG_ZEROED;
+        memory_stats.zero_pool_pages--;
+        memory_stats.zero_pool_hits++;
+        irq_restore(flags);
+        return (uint32_t)node;
+    }
+    
+    memory_stats.zero_pool_misses++;
+    irq_restore(flags);
+    uint32_t page = alloc_page_or_reclaim();
+    if (page) {
+        memset((void*)page, 0, PAGE_SIZE);
     }
-    return page * PAGE_SIZE;
+    return page;
+}
+
+// 预先清零最多max_pages个页面放入池中，返回本次清零的页数（由空闲进程调用）
+uint32_t refill_zeroed_pages(uint32_t max_pages) {
+    uint32_t filled = 0;
+    
+    // 不把空闲页压到high水位以下，免得清零池自己触发回收
+    while (filled < max_pages && memory_stats.zero_pool_pages < ZERO_PAGE_POOL_MAX &&
+           buddy_free_pages > watermark_high) {
+        uint32_t page = alloc_physical_pages(0);
+        if (!page) {
+            break;
+        }
+        
+        memset((void*)page, 0, PAGE_SIZE);
+        uint32_t flags = irq_save();
+        buddy_block_t* node = (buddy_block_t*)page;
+        node->next = zero_page_pool;
+        zero_page_pool = node;
+        phys_to_page(page)->flags |= PG_ZEROED;
+        memory_stats.zero_pool_pages++;
+        irq_restore(flags);
+        filled++;
+    }
+    return filled;
 }
 
 // 释放物理页面
 void free_physical_page(uint32_t page) {
-    uint32_t page_num = page / PAGE_SIZE;
-    if (page_num < (bitmap_size * 32)) {
-        set_bitmap_bit(page_num, false);
-        memory_stats.page_deallocations++;
-        update_memory_stats();
-    }
-}
-
-// 查找空闲物理页面
-static uint32_t find_free_physical_page(void) {
-    for (uint32_t i = 0; i < bitmap_size; i++) {
-        if (physical_page_bitmap[i] != 0xFFFFFFFF) {
-            // 在这个uint32_t中找到第一个0位
-            for (uint32_t j = 0; j < 32; j++) {
-                if (!(physical_page_bitmap[i] & (1 << j))) {
-                    return i * 32 + j;
-                }
-            }
-        }
+    free_physical_pages(page, 0);
+}
+
+// 获取空闲物理页面数
+uint32_t get_free_physical_pages(void) {
+    return buddy_free_pages;
+}
+
+// 批量设置位图位
+static void set_bitmap_range(uint32_t pfn, uint32_t count, bool set) {
+    for (uint32_t i = 0; i < count; i++) {
+        set_bitmap_bit(pfn + i, set);
     }
-    return 0; // 没有找到空闲页面
 }
 
 // 设置位图位
@@ -190,223 +633,598 @@ static bool get_bitmap_bit(uint32_t page) {
     return (physical_page_bitmap[index] & (1 << bit)) != 0;
 }
 
-// 映射页面
-bool map_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags) {
+// 查找页表项，必要时创建页表
+static page_entry_t* get_page_entry(page_directory_t* pd, uint32_t virtual_addr, bool create) {
     uint32_t pd_index = get_page_directory_index(virtual_addr);
     uint32_t pt_index = get_page_table_index(virtual_addr);
     
+    // 4MB大页没有页表，不存在对应的页表项
+    if (pd->entries[pd_index].present && pd->entries[pd_index].size) {
+        return NULL;
+    }
+    
     // 检查页目录项是否存在
-    if (!(current_page_directory->entries[pd_index].present)) {
+    if (!pd->entries[pd_index].present) {
+        if (!create) {
+            return NULL;
+        }
+        
         // 创建页表
         page_table_t* pt = create_page_table();
         if (!pt) {
-            return false;
+            return NULL;
         }
         
-        // 设置页目录项
-        current_page_directory->entries[pd_index].address = ((uint32_t)pt) >> 12;
-        current_page_directory->entries[pd_index].present = 1;
-        current_page_directory->entries[pd_index].rw = 1;
-        current_page_directory->entries[pd_index].user = 1;
+        // 设置页目录项（用户空间的页表允许用户访问，具体权限由页表项决定）
+        pd->entries[pd_index].address = ((uint32_t)pt) >> 12;
+        pd->entries[pd_index].present = 1;
+        pd->entries[pd_index].rw = 1;
+        pd->entries[pd_index].user =
+            (virtual_addr >= USER_SPACE_START && virtual_addr < USER_STACK_TOP) ? 1 : 0;
     }
     
-    // 获取页表
-    page_table_t* pt = (page_table_t*)(current_page_directory->entries[pd_index].address << 12);
+    page_table_t* pt = (page_table_t*)(pd->entries[pd_index].address << 12);
+    return &pt->entries[pt_index];
+}
+
+// 在指定页目录中映射页面
+static bool map_page_in(page_directory_t* pd, uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags) {
+    page_entry_t* entry = get_page_entry(pd, virtual_addr, true);
+    if (!entry) {
+        return false;
+    }
     
     // 设置页表项
-    pt->entries[pt_index].address = physical_addr >> 12;
-    pt->entries[pt_index].present = (flags & PAGE_PRESENT) ? 1 : 0;
-    pt->entries[pt_index].rw = (flags & PAGE_WRITABLE) ? 1 : 0;
-    pt->entries[pt_index].user = (flags & PAGE_USER) ? 1 : 0;
-    pt->entries[pt_index].global = (flags & PAGE_GLOBAL) ? 1 : 0;
+    entry->address = physical_addr >> 12;
+    entry->present = (flags & PAGE_PRESENT) ? 1 : 0;
+    entry->rw = (flags & PAGE_WRITABLE) ? 1 : 0;
+    entry->user = (flags & PAGE_USER) ? 1 : 0;
+    entry->global = (flags & PAGE_GLOBAL) ? 1 : 0;
+    entry->available = ((flags & PAGE_COW) ? 1 : 0) | ((flags & PAGE_SWAPPED) ? 2 : 0);
+    
+    return true;
+}
+
+// 在进程上下文中映射用户页面，新建的页表计入该上下文
+static bool map_user_page(memory_context_t* ctx, uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags) {
+    bool had_table = ctx->page_dir->entries[get_page_directory_index(virtual_addr)].present;
+    
+    if (!map_page_in(ctx->page_dir, virtual_addr, physical_addr, flags)) {
+        return false;
+    }
+    if (!had_table) {
+        ctx->page_tables++;
+    }
+    return true;
+}
+
+// 映射页面
+bool map_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags) {
+    return map_page_in(current_page_directory, virtual_addr, physical_addr, flags);
+}
+
+// 用一个页目录项映射4MB大页（需要PSE，地址必须4MB对齐，且该目录项不能已经指向页表）
+bool map_large_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags) {
+    if (!pse_enabled ||
+        (virtual_addr & (LARGE_PAGE_SIZE - 1)) || (physical_addr & (LARGE_PAGE_SIZE - 1))) {
+        return false;
+    }
+    
+    page_entry_t* entry = &current_page_directory->entries[get_page_directory_index(virtual_addr)];
+    if (entry->present && !entry->size) {
+        return false;
+    }
+    
+    memset(entry, 0, sizeof(page_entry_t));
+    entry->address = physical_addr >> 12;
+    entry->present = (flags & PAGE_PRESENT) ? 1 : 0;
+    entry->rw = (flags & PAGE_WRITABLE) ? 1 : 0;
+    entry->user = (flags & PAGE_USER) ? 1 : 0;
+    entry->global = (flags & PAGE_GLOBAL) ? 1 : 0;
+    entry->size = 1;
     
     return true;
 }
 
+// 是否使用4MB大页
+bool is_pse_enabled(void) {
+    return pse_enabled;
+}
+
 // 取消映射页面
 bool unmap_page(uint32_t virtual_addr) {
-    uint32_t pd_index = get_page_directory_index(virtual_addr);
-    uint32_t pt_index = get_page_table_index(virtual_addr);
-    
-    if (!current_page_directory->entries[pd_index].present) {
+    page_entry_t* entry = get_page_entry(current_page_directory, virtual_addr, false);
+    if (!entry) {
         return false;
     }
     
-    page_table_t* pt = (page_table_t*)(current_page_directory->entries[pd_index].address << 12);
-    pt->entries[pt_index].present = 0;
+    entry->present = 0;
+    invalidate_page(virtual_addr);
     
     return true;
 }
 
-// 创建页表
+// 创建页表：优先复用回收池中的页帧，池空时向伙伴系统申请
 page_table_t* create_page_table(void) {
-    // 在分页启用前，使用简单的内存分配
-    static uint32_t next_page_table_addr = 0x700000; // 从7MB开始分配页表
-    uint32_t page_addr = next_page_table_addr;
-    next_page_table_addr += PAGE_SIZE;
+    page_table_t* pt;
+    
+    if (page_table_pool) {
+        pt = (page_table_t*)page_table_pool;
+        page_table_pool = page_table_pool->next;
+        memory_stats.page_table_pool_pages--;
+        memset(pt, 0, sizeof(page_table_t));
+    } else {
+        pt = (page_table_t*)alloc_zeroed_page();
+        if (!pt) {
+            return NULL;
+        }
+        phys_to_page((uint32_t)pt)->flags |= PG_PAGE_TABLE;
+    }
     
-    page_table_t* pt = (page_table_t*)page_addr;
-    memset(pt, 0, sizeof(page_table_t));
+    memory_stats.page_table_pages++;
     return pt;
 }
 
-// 销毁页表
+// 销毁页表：放回回收池，池满时归还伙伴系统
 void destroy_page_table(page_table_t* pt) {
-    if (pt) {
+    if (!pt) {
+        return;
+    }
+    
+    memory_stats.page_table_pages--;
+    if (memory_stats.page_table_pool_pages >= PAGE_TABLE_POOL_MAX) {
+        phys_to_page((uint32_t)pt)->flags &= ~PG_PAGE_TABLE;
         free_physical_page((uint32_t)pt);
+        return;
     }
+    
+    buddy_block_t* node = (buddy_block_t*)pt;
+    node->next = page_table_pool;
+    page_table_pool = node;
+    memory_stats.page_table_pool_pages++;
 }
 
 // 内核内存分配
 void* kmalloc(size_t size) {
+    return kmalloc_tracked(size, (uint32_t)__builtin_return_address(0));
+}
+
+// 按调用点记录的分配：caller是外部调用者的返回地址
+// 内核线程可被时钟抢占，堆和slab的操作都在关中断下进行
+static void* kmalloc_tracked(size_t size, uint32_t caller) {
+    uint32_t flags = irq_save();
+    void* ptr = kmalloc_nolock(size, caller);
+    irq_restore(flags);
+    return ptr;
+}
+
+static void* kmalloc_nolock(size_t size, uint32_t caller) {
     if (size == 0) {
         return NULL;
     }
     
-    // 对齐到4字节边界
-    size = (size + 3) & ~3;
+    // 小对象走slab缓存，O(1)且不会在堆中产生碎片；开启分析器时对象前留出标签，
+    // 所以1017~1024字节的请求放不进kmalloc-1024，改走通用堆（MEMPROF=0时仍走slab）
+    if (size + KMALLOC_TAG_SIZE <= KMALLOC_MAX_SIZE) {
+        void* object = kmalloc_small(size + KMALLOC_TAG_SIZE);
+        if (object) {
+            void* ptr = (void*)((uint32_t)object + KMALLOC_TAG_SIZE);
+            account_alloc(kmem_object_size(object));
+            profile_alloc(ptr, kmem_object_size(object), caller);
+            return ptr;
+        }
+    }
     
-    memory_block_t* block = find_free_block(size);
+    uint32_t block_size = heap_block_size(size);
+    memory_block_t* block = find_free_block(block_size);
     if (!block) {
+        block = heap_grow_for(block_size);
+        if (!block) {
+            return NULL;
+        }
+    }
+    
+    heap_remove_free(block);
+    block->type = MEMORY_ALLOCATED;
+    split_block(block, block_size);
+    account_alloc(block->size);
+    
+    void* ptr = (void*)((uint32_t)block + HEAP_BLOCK_HEADER_SIZE);
+    profile_alloc(ptr, block->size, caller);
+    return ptr;
+}
+
+// 分配按align对齐的内核内存（align为2的幂），用kfree释放
+// 从堆中多取一段，把对齐点之前的部分切成独立的空闲块还回去
+void* kmalloc_aligned(size_t size, size_t align) {
+    uint32_t flags = irq_save();
+    void* ptr = kmalloc_aligned_nolock(size, align, (uint32_t)__builtin_return_address(0));
+    irq_restore(flags);
+    return ptr;
+}
+
+static void* kmalloc_aligned_nolock(size_t size, size_t align, uint32_t caller) {
+    if (size == 0 || (align & (align - 1))) {
         return NULL;
     }
+    if (align <= HEAP_ALIGN) {
+        return kmalloc_nolock(size, caller);
+    }
     
-    if (block->size > size + sizeof(memory_block_t)) {
-        block = split_block(block, size);
+    uint32_t block_size = heap_block_size(size);
+    memory_block_t* block = find_free_block(block_size + align + HEAP_MIN_BLOCK_SIZE);
+    if (!block) {
+        block = heap_grow_for(block_size + align + HEAP_MIN_BLOCK_SIZE);
+        if (!block) {
+            return NULL;
+        }
     }
+    heap_remove_free(block);
     
-    block->type = MEMORY_ALLOCATED;
-    update_memory_stats();
+    // 前面切出的部分至少要能构成一个最小的空闲块
+    uint32_t payload = ((uint32_t)block + HEAP_BLOCK_HEADER_SIZE + align - 1) & ~(align - 1);
+    while (payload - HEAP_BLOCK_HEADER_SIZE != (uint32_t)block &&
+           payload - HEAP_BLOCK_HEADER_SIZE - (uint32_t)block < HEAP_MIN_BLOCK_SIZE) {
+        payload += align;
+    }
     
-    return (void*)(block->start_addr);
+    memory_block_t* aligned = (memory_block_t*)(payload - HEAP_BLOCK_HEADER_SIZE);
+    if (aligned != block) {
+        uint32_t lead_size = (uint32_t)aligned - (uint32_t)block;
+        uint32_t rest_size = block->size - lead_size;
+        set_block(aligned, rest_size, MEMORY_ALLOCATED);   // 先写好头部，合并时不会误判
+        set_block(block, lead_size, MEMORY_FREE);
+        heap_insert_free(coalesce_block(block));
+    } else {
+        aligned->type = MEMORY_ALLOCATED;
+    }
+    
+    split_block(aligned, block_size);
+    account_alloc(aligned->size);
+    profile_alloc((void*)payload, aligned->size, caller);
+    return (void*)payload;
 }
 
 // 内核内存释放
 void kfree(void* ptr) {
+    uint32_t flags = irq_save();
+    kfree_nolock(ptr);
+    irq_restore(flags);
+}
+
+static void kfree_nolock(void* ptr) {
     if (!ptr) {
         return;
     }
     
+    // 不在堆范围内的指针来自slab缓存
+    if (!is_heap_pointer(ptr)) {
+        void* object = (void*)((uint32_t)ptr - KMALLOC_TAG_SIZE);
+        uint32_t object_size = kmem_object_size(object);
+        if (object_size) {
+            profile_free(ptr, object_size);
+            account_free(object_size);
+            kmem_free(object);
+        }
+        return;
+    }
+    
     // 找到对应的内存块
-    memory_block_t* block = (memory_block_t*)((uint32_t)ptr - sizeof(memory_block_t));
+    memory_block_t* block = (memory_block_t*)((uint32_t)ptr - HEAP_BLOCK_HEADER_SIZE);
     
     if (block->type == MEMORY_ALLOCATED) {
+        profile_free(ptr, block->size);
+        account_free(block->size);
         block->type = MEMORY_FREE;
-        merge_adjacent_blocks();
-        update_memory_stats();
+        block = coalesce_block(block);
+        heap_insert_free(block);
+        heap_trim(block);
     }
 }
 
-// 查找空闲内存块
-static memory_block_t* find_free_block(size_t size) {
-    memory_block_t* current = memory_map;
+// 移动堆的末尾（brk风格）：正数映射新页面并入末尾的空闲块，负数只能归还末尾空闲块中的整页
+bool heap_expand(int32_t increment) {
+    memory_block_t* epilogue = (memory_block_t*)(heap_end - HEAP_BLOCK_HEADER_SIZE);
     
-    while (current) {
-        if (current->type == MEMORY_FREE && current->size >= size) {
-            return current;
+    if (increment > 0) {
+        uint32_t grow = align_to_page((uint32_t)increment);
+        if (grow > heap_start + KERNEL_HEAP_MAX_SIZE - heap_end) {
+            return false;
+        }
+        if (!map_kernel_pages(heap_end, heap_end + grow)) {
+            return false;
         }
-        current = current->next;
+        heap_end += grow;
+        memory_stats.heap_size += grow;
+        
+        // 原来的哨兵块成为新空闲块的头部，新的哨兵块放在新末尾
+        set_block(epilogue, grow, MEMORY_FREE);
+        memory_block_t* new_epilogue = next_physical_block(epilogue);
+        new_epilogue->size = 0;
+        new_epilogue->type = MEMORY_ALLOCATED;
+        heap_insert_free(coalesce_block(epilogue));
+        return true;
     }
     
-    return NULL;
-}
-
-// 分割内存块
-static memory_block_t* split_block(memory_block_t* block, size_t size) {
-    if (block->size <= size + sizeof(memory_block_t)) {
-        return block;
+    uint32_t shrink = align_to_page((uint32_t)-increment);
+    if (shrink == 0) {
+        return true;
     }
     
-    // 创建新块
-    memory_block_t* new_block = (memory_block_t*)(block->start_addr + size);
-    new_block->start_addr = block->start_addr + size + sizeof(memory_block_t);
-    new_block->size = block->size - size - sizeof(memory_block_t);
-    new_block->type = MEMORY_FREE;
-    new_block->next = block->next;
-    new_block->prev = block;
-    
-    // 更新原块
-    block->size = size;
-    block->next = new_block;
-    
-    // 更新下一个块的prev指针
-    if (new_block->next) {
-        new_block->next->prev = new_block;
+    // 末尾必须是足够大的空闲块，收缩后仍要留下一个合法的空闲块
+    uint32_t tail_footer = *(uint32_t*)((uint32_t)epilogue - HEAP_BLOCK_FOOTER_SIZE);
+    memory_block_t* tail = (memory_block_t*)((uint32_t)epilogue - tail_footer);
+    if (tail->type != MEMORY_FREE || tail->size < shrink + HEAP_MIN_BLOCK_SIZE ||
+        heap_end - shrink < heap_start + KERNEL_HEAP_SIZE) {
+        return false;
     }
     
-    return block;
-}
-
-// 合并相邻的空闲块
-static void merge_adjacent_blocks(void) {
-    memory_block_t* current = memory_map;
+    heap_remove_free(tail);
+    set_block(tail, tail->size - shrink, MEMORY_FREE);
+    heap_insert_free(tail);
     
-    while (current && current->next) {
-        if (current->type == MEMORY_FREE && 
-            current->next->type == MEMORY_FREE &&
-            current->start_addr + current->size + sizeof(memory_block_t) == current->next->start_addr) {
-            
-            // 合并块
-            current->size += current->next->size + sizeof(memory_block_t);
-            current->next = current->next->next;
-            
-            if (current->next) {
-                current->next->prev = current;
-            }
-        } else {
-            current = current->next;
-        }
-    }
+    heap_end -= shrink;
+    memory_stats.heap_size -= shrink;
+    epilogue = next_physical_block(tail);
+    epilogue->size = 0;
+    epilogue->type = MEMORY_ALLOCATED;
+    unmap_kernel_pages(heap_end, heap_end + shrink);
+    return true;
 }
 
-// 更新内存统计
-static void update_memory_stats(void) {
-    memory_stats.used_memory = 0;
-    memory_stats.free_memory = 0;
-    
-    memory_block_t* current = memory_map;
-    while (current) {
-        if (current->type == MEMORY_ALLOCATED) {
-            memory_stats.used_memory += current->size;
-        } else if (current->type == MEMORY_FREE) {
-            memory_stats.free_memory += current->size;
-        }
-        current = current->next;
+// 找不到空闲块时扩展堆，返回合并后位于末尾的空闲块
+static memory_block_t* heap_grow_for(uint32_t block_size) {
+    uint32_t grow = block_size < HEAP_GROW_MIN ? HEAP_GROW_MIN : block_size;
+    if (!heap_expand((int32_t)grow)) {
+        return NULL;
     }
+    
+    memory_block_t* epilogue = (memory_block_t*)(heap_end - HEAP_BLOCK_HEADER_SIZE);
+    uint32_t tail_footer = *(uint32_t*)((uint32_t)epilogue - HEAP_BLOCK_FOOTER_SIZE);
+    memory_block_t* tail = (memory_block_t*)((uint32_t)epilogue - tail_footer);
+    return tail->size >= block_size ? tail : NULL;
 }
 
-// 获取物理地址
-uint32_t get_physical_address(uint32_t virtual_addr) {
-    uint32_t pd_index = get_page_directory_index(virtual_addr);
-    uint32_t pt_index = get_page_table_index(virtual_addr);
-    
-    if (!current_page_directory->entries[pd_index].present) {
-        return 0;
+// 刚释放的块位于堆末尾且足够大时，把多余的整页还给伙伴系统（保留HEAP_GROW_MIN余量）
+static void heap_trim(memory_block_t* block) {
+    if (next_physical_block(block)->size != 0 || block->size < HEAP_SHRINK_THRESHOLD) {
+        return;
     }
     
-    page_table_t* pt = (page_table_t*)(current_page_directory->entries[pd_index].address << 12);
-    if (!pt->entries[pt_index].present) {
-        return 0;
+    uint32_t excess = (block->size - HEAP_GROW_MIN) & ~(PAGE_SIZE - 1);
+    uint32_t shrinkable = heap_end - (heap_start + KERNEL_HEAP_SIZE);
+    if (excess > shrinkable) {
+        excess = shrinkable;
+    }
+    if (excess) {
+        heap_expand(-(int32_t)excess);
     }
-    
-    return (pt->entries[pt_index].address << 12) | get_page_offset(virtual_addr);
 }
 
-// 工具函数
-uint32_t align_to_page(uint32_t addr) {
-    return (addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+// 判断指针是否位于内核堆中
+static bool is_heap_pointer(void* ptr) {
+    return (uint32_t)ptr >= heap_start && (uint32_t)ptr < heap_end;
 }
 
-uint32_t get_page_directory_index(uint32_t virtual_addr) {
-    return (virtual_addr >> 22) & 0x3FF;
+// 计算满足请求所需的块大小（含边界标记，按8字节对齐）
+static uint32_t heap_block_size(size_t size) {
+    uint32_t block_size = (size + HEAP_BLOCK_OVERHEAD + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    if (block_size < HEAP_MIN_BLOCK_SIZE) {
+        block_size = HEAP_MIN_BLOCK_SIZE;
+    }
+    return block_size;
 }
 
-uint32_t get_page_table_index(uint32_t virtual_addr) {
-    return (virtual_addr >> 12) & 0x3FF;
+// 计算块大小对应的一级/二级索引
+static void tlsf_mapping(uint32_t size, uint32_t* fl, uint32_t* sl) {
+    if (size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_BLOCK / TLSF_SL_COUNT);
+    } else {
+        uint32_t msb = 31 - __builtin_clz(size);
+        *sl = (size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = msb - (TLSF_FL_SHIFT - 1);
+    }
 }
 
-uint32_t get_page_offset(uint32_t virtual_addr) {
-    return virtual_addr & 0xFFF;
+// 把空闲块插入对应的分级链表
+static void heap_insert_free(memory_block_t* block) {
+    uint32_t fl, sl;
+    tlsf_mapping(block->size, &fl, &sl);
+    
+    block->prev = NULL;
+    block->next = heap_free_lists[fl][sl];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    heap_free_lists[fl][sl] = block;
+    
+    heap_fl_bitmap |= 1U << fl;
+    heap_sl_bitmap[fl] |= 1U << sl;
+    memory_stats.heap_free_memory += block->size;
+}
+
+// 从分级链表中摘除空闲块
+static void heap_remove_free(memory_block_t* block) {
+    uint32_t fl, sl;
+    tlsf_mapping(block->size, &fl, &sl);
+    
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        heap_free_lists[fl][sl] = block->next;
+        if (!block->next) {
+            heap_sl_bitmap[fl] &= ~(1U << sl);
+            if (!heap_sl_bitmap[fl]) {
+                heap_fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    memory_stats.heap_free_memory -= block->size;
+}
+
+// 查找空闲内存块：通过位图O(1)定位第一个足够大的非空分级
+static memory_block_t* find_free_block(size_t size) {
+    if (size >= (1U << 31)) {
+        return NULL;
+    }
+    
+    // 向上取整到下一个分级的起点，保证该分级中任何块都能满足请求
+    if (size >= TLSF_SMALL_BLOCK) {
+        size += (1U << (31 - __builtin_clz(size) - TLSF_SL_LOG2)) - 1;
+    }
+    
+    uint32_t fl, sl;
+    tlsf_mapping(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+    
+    uint32_t sl_map = heap_sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        uint32_t fl_map = heap_fl_bitmap & (~0U << (fl + 1));
+        if (!fl_map) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap_sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    
+    return heap_free_lists[fl][sl];
+}
+
+// 写入块的头尾边界标记
+static void set_block(memory_block_t* block, uint32_t size, memory_type_t type) {
+    block->size = size;
+    block->type = type;
+    *(uint32_t*)((uint32_t)block + size - HEAP_BLOCK_FOOTER_SIZE) = size;
+}
+
+// 物理上相邻的下一个块
+static memory_block_t* next_physical_block(memory_block_t* block) {
+    return (memory_block_t*)((uint32_t)block + block->size);
+}
+
+// 分割内存块：把多余部分作为空闲块放回链表
+static void split_block(memory_block_t* block, size_t size) {
+    if (block->size < size + HEAP_MIN_BLOCK_SIZE) {
+        return;
+    }
+    
+    uint32_t remainder_size = block->size - size;
+    set_block(block, size, block->type);
+    
+    memory_block_t* remainder = next_physical_block(block);
+    set_block(remainder, remainder_size, MEMORY_FREE);
+    heap_insert_free(coalesce_block(remainder));
+}
+
+// 与物理上相邻的空闲块合并（只检查前后两个邻居）
+static memory_block_t* coalesce_block(memory_block_t* block) {
+    uint32_t size = block->size;
+    
+    memory_block_t* next = next_physical_block(block);
+    if (next->type == MEMORY_FREE) {
+        heap_remove_free(next);
+        size += next->size;
+    }
+    
+    if ((uint32_t)block > heap_start) {
+        uint32_t prev_size = *(uint32_t*)((uint32_t)block - HEAP_BLOCK_FOOTER_SIZE);
+        memory_block_t* prev = (memory_block_t*)((uint32_t)block - prev_size);
+        if (prev->type == MEMORY_FREE) {
+            heap_remove_free(prev);
+            size += prev->size;
+            block = prev;
+        }
+    }
+    
+    set_block(block, size, MEMORY_FREE);
+    return block;
+}
+
+// 计算统计用的大小级别
+static uint32_t memory_size_class(uint32_t size) {
+    if (size > KMALLOC_MAX_SIZE) {
+        return MEMORY_SIZE_CLASSES - 1;
+    }
+    if (size <= KMALLOC_MIN_SIZE) {
+        return 0;
+    }
+    // 向上取整到2的幂后相对kmalloc-8的级数
+    return (32 - __builtin_clz(size - 1)) - 3;
+}
+
+// 记录一次分配（只做加减，不遍历任何链表）
+static void account_alloc(uint32_t size) {
+    uint32_t class_index = memory_size_class(size);
+    memory_stats.class_allocations[class_index]++;
+    memory_stats.class_live[class_index]++;
+    
+    memory_stats.used_memory += size;
+    if (memory_stats.used_memory > memory_stats.peak_used_memory) {
+        memory_stats.peak_used_memory = memory_stats.used_memory;
+    }
+}
+
+// 记录一次释放
+static void account_free(uint32_t size) {
+    memory_stats.class_live[memory_size_class(size)]--;
+    memory_stats.used_memory -= size;
+}
+
+// 把分配记到调用点上；标签总是紧贴在返回给调用者的指针之前
+static void profile_alloc(void* ptr, uint32_t size, uint32_t caller) {
+#ifdef CONFIG_MEMPROF
+    memprof_record_alloc((memprof_tag_t*)ptr - 1, caller, size);
+#else
+    (void)ptr; (void)size; (void)caller;
+#endif
+}
+
+// 从分配时的调用点上减去
+static void profile_free(void* ptr, uint32_t size) {
+#ifdef CONFIG_MEMPROF
+    memprof_record_free((memprof_tag_t*)ptr - 1, size);
+#else
+    (void)ptr; (void)size;
+#endif
+}
+
+// 获取物理地址
+uint32_t get_physical_address(uint32_t virtual_addr) {
+    page_entry_t* pde = &current_page_directory->entries[get_page_directory_index(virtual_addr)];
+    if (pde->present && pde->size) {
+        return (pde->address << 12) | (virtual_addr & (LARGE_PAGE_SIZE - 1));
+    }
+    
+    page_entry_t* entry = get_page_entry(current_page_directory, virtual_addr, false);
+    if (!entry || !entry->present) {
+        return 0;
+    }
+    
+    return (entry->address << 12) | get_page_offset(virtual_addr);
+}
+
+// 工具函数
+uint32_t align_to_page(uint32_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+uint32_t get_page_directory_index(uint32_t virtual_addr) {
+    return (virtual_addr >> 22) & 0x3FF;
+}
+
+uint32_t get_page_table_index(uint32_t virtual_addr) {
+    return (virtual_addr >> 12) & 0x3FF;
+}
+
+uint32_t get_page_offset(uint32_t virtual_addr) {
+    return virtual_addr & 0xFFF;
 }
 
 bool is_page_aligned(uint32_t addr) {
@@ -444,6 +1262,105 @@ void print_memory_info(void) {
     vga_putstr("Page Faults: ");
     vga_puthex(memory_stats.page_faults);
     vga_putstr("\n");
+    
+    vga_putstr("COW Faults: ");
+    vga_puthex(memory_stats.cow_faults);
+    vga_putstr("\n");
+    
+    vga_putstr("User Memory: ");
+    vga_puthex(memory_stats.user_memory);
+    vga_putstr(" bytes\n");
+    
+    vga_putstr("Peak Used Memory: ");
+    vga_puthex(memory_stats.peak_used_memory);
+    vga_putstr(" bytes\n");
+    
+    vga_putstr("Heap Free Memory: ");
+    vga_puthex(memory_stats.heap_free_memory);
+    vga_putstr(" bytes\n");
+    
+    vga_putstr("Heap Size: ");
+    vga_puthex(memory_stats.heap_size);
+    vga_putstr(" bytes\n");
+    
+    vga_putstr("Page Tables (live/pooled): ");
+    vga_puthex(memory_stats.page_table_pages);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.page_table_pool_pages);
+    vga_putstr("\n");
+    
+    vga_putstr("Zeroed Pool (pages/hits/misses): ");
+    vga_puthex(memory_stats.zero_pool_pages);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.zero_pool_hits);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.zero_pool_misses);
+    vga_putstr("\n");
+    
+    vga_putstr("Vmalloc Pages: ");
+    vga_puthex(memory_stats.vmalloc_pages);
+    vga_putstr("\n");
+    
+    vga_putstr("LRU Pages (active/inactive): ");
+    vga_puthex(memory_stats.lru_pages[LRU_ACTIVE]);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.lru_pages[LRU_INACTIVE]);
+    vga_putstr("\n");
+    
+    vga_putstr("Reclaim (scanned/freed/direct): ");
+    vga_puthex(memory_stats.reclaim_scanned);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.reclaimed_pages);
+    vga_putstr(" / ");
+    vga_puthex(memory_stats.direct_reclaims);
+    vga_putstr("\n");
+    
+    vga_putstr("Watermarks (min/low/high): ");
+    vga_puthex(watermark_min);
+    vga_putstr(" / ");
+    vga_puthex(watermark_low);
+    vga_putstr(" / ");
+    vga_puthex(watermark_high);
+    vga_putstr("\n");
+    
+    vga_putstr("Kernel Map Pages: ");
+    vga_putstr(pse_enabled ? "4MB (PSE)" : "4KB");
+    vga_putstr("\n");
+    
+    vga_putstr("Physical Pages: ");
+    vga_puthex(total_pages);
+    vga_putstr("\n");
+    
+    vga_putstr("Free Physical Pages: ");
+    vga_puthex(buddy_free_pages);
+    vga_putstr("\n");
+    
+    vga_putstr("Free Pages (DMA/Normal): ");
+    vga_puthex(zone_free_pages[ZONE_DMA]);
+    vga_putstr(" / ");
+    vga_puthex(zone_free_pages[ZONE_NORMAL]);
+    vga_putstr("\n");
+    
+    vga_putstr("Buddy Free Blocks (order 0-10):");
+    for (uint32_t order = 0; order <= BUDDY_MAX_ORDER; order++) {
+        vga_putstr(" ");
+        vga_puthex(buddy_free_blocks[order]);
+    }
+    vga_putstr("\n");
+    
+    vga_putstr("Size Class  Live      Total\n");
+    for (uint32_t i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+        if (i == MEMORY_SIZE_CLASSES - 1) {
+            vga_putstr(">1024       ");
+        } else {
+            vga_puthex(KMALLOC_MIN_SIZE << i);
+            vga_putstr("  ");
+        }
+        vga_puthex(memory_stats.class_live[i]);
+        vga_putstr("  ");
+        vga_puthex(memory_stats.class_allocations[i]);
+        vga_putstr("\n");
+    }
 }
 
 // 打印内存映射
@@ -452,9 +1369,9 @@ void print_memory_map(void) {
     vga_putstr("Address\t\tSize\t\tType\n");
     vga_putstr("----------------------------------------\n");
     
-    memory_block_t* current = memory_map;
-    while (current) {
-        vga_puthex(current->start_addr);
+    memory_block_t* current = (memory_block_t*)heap_start;
+    while (current->size != 0) {
+        vga_puthex((uint32_t)current + HEAP_BLOCK_HEADER_SIZE);
         vga_putstr("\t");
         vga_puthex(current->size);
         vga_putstr("\t\t");
@@ -475,7 +1392,7 @@ void print_memory_map(void) {
         }
         vga_putstr("\n");
         
-        current = current->next;
+        current = next_physical_block(current);
     }
 }
 
@@ -499,7 +1416,7 @@ void invalidate_page(uint32_t virtual_addr) {
 
 // 其他函数的简单实现
 void* kcalloc(size_t num, size_t size) {
-    void* ptr = kmalloc(num * size);
+    void* ptr = kmalloc_tracked(num * size, (uint32_t)__builtin_return_address(0));
     if (ptr) {
         memset(ptr, 0, num * size);
     }
@@ -507,35 +1424,181 @@ void* kcalloc(size_t num, size_t size) {
 }
 
 void* krealloc(void* ptr, size_t size) {
+    uint32_t flags = irq_save();
+    void* new_ptr = krealloc_nolock(ptr, size, (uint32_t)__builtin_return_address(0));
+    irq_restore(flags);
+    return new_ptr;
+}
+
+static void* krealloc_nolock(void* ptr, size_t size, uint32_t caller) {
     if (!ptr) {
-        return kmalloc(size);
+        return kmalloc_nolock(size, caller);
     }
     
     if (size == 0) {
-        kfree(ptr);
+        kfree_nolock(ptr);
         return NULL;
     }
     
-    // 简单实现：分配新内存并复制数据
-    void* new_ptr = kmalloc(size);
+    // slab对象：放得下就原地返回
+    if (!is_heap_pointer(ptr)) {
+        size_t old_size = kmem_object_size((void*)((uint32_t)ptr - KMALLOC_TAG_SIZE)) - KMALLOC_TAG_SIZE;
+        if (size <= old_size) {
+            return ptr;
+        }
+        
+        void* new_ptr = kmalloc_nolock(size, caller);
+        if (new_ptr) {
+            memcpy(new_ptr, ptr, old_size);
+            kfree_nolock(ptr);
+        }
+        return new_ptr;
+    }
+    
+    memory_block_t* block = (memory_block_t*)((uint32_t)ptr - HEAP_BLOCK_HEADER_SIZE);
+    uint32_t block_size = heap_block_size(size);
+    
+    // 缩小：原地切掉尾部
+    if (block_size <= block->size) {
+        profile_free(ptr, block->size);
+        account_free(block->size);
+        split_block(block, block_size);
+        account_alloc(block->size);
+        profile_alloc(ptr, block->size, caller);
+        return ptr;
+    }
+    
+    // 增长：下一个块空闲且足够大时原地扩展
+    memory_block_t* next = next_physical_block(block);
+    if (next->type == MEMORY_FREE && block->size + next->size >= block_size) {
+        profile_free(ptr, block->size);
+        account_free(block->size);
+        heap_remove_free(next);
+        set_block(block, block->size + next->size, MEMORY_ALLOCATED);
+        split_block(block, block_size);
+        account_alloc(block->size);
+        profile_alloc(ptr, block->size, caller);
+        return ptr;
+    }
+    
+    // 否则分配新内存并复制数据
+    void* new_ptr = kmalloc_nolock(size, caller);
     if (new_ptr) {
-        // 这里需要知道原块的大小，简化处理
-        memcpy(new_ptr, ptr, size);
-        kfree(ptr);
+        memcpy(new_ptr, ptr, block->size - HEAP_BLOCK_OVERHEAD);
+        kfree_nolock(ptr);
     }
     
     return new_ptr;
 }
 
+// 预先建好内核窗口的全部页表：内核目录项在创建上下文时被复制，之后新建的页表其他上下文看不到
+static void reserve_kernel_page_tables(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += LARGE_PAGE_SIZE) {
+        get_page_entry(kernel_page_directory, addr, true);
+    }
+}
+
+// 逐页分配页帧映射到内核窗口[start, end)，失败时回滚已经映射的页面
+static bool map_kernel_pages(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        uint32_t page = alloc_physical_page();
+        if (!page || !map_page_in(kernel_page_directory, addr, page, PAGE_PRESENT | PAGE_WRITABLE)) {
+            if (page) {
+                free_physical_page(page);
+            }
+            unmap_kernel_pages(start, addr);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 解除内核窗口[start, end)的映射并归还页帧
+static void unmap_kernel_pages(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        page_entry_t* entry = get_page_entry(kernel_page_directory, addr, false);
+        free_physical_page(entry->address << 12);
+        memset(entry, 0, sizeof(page_entry_t));
+        invalidate_page(addr);
+    }
+}
+
+// 建立vmalloc区域
+void vmalloc_init(void) {
+    vmalloc_area_cache = kmem_cache_create("vmalloc_area", sizeof(vmalloc_area_t), 0, NULL);
+    vmalloc_areas = NULL;
+    reserve_kernel_page_tables(VMALLOC_START, VMALLOC_END);
+}
+
+// 分配虚拟连续、物理上可以分散的内核内存：逐页从伙伴系统取页帧映射到vmalloc区域
 void* vmalloc(size_t size) {
-    // 虚拟内存分配，简化实现
-    return kmalloc(size);
+    if (size == 0 || size > VMALLOC_SIZE) {
+        return NULL;
+    }
+    uint32_t pages = align_to_page(size) / PAGE_SIZE;
+    
+    // 首次适配查找空闲地址范围，每个区域后面留一个未映射的保护页
+    uint32_t addr = VMALLOC_START;
+    vmalloc_area_t** link = &vmalloc_areas;
+    while (*link && (*link)->addr < addr + (pages + 1) * PAGE_SIZE) {
+        addr = (*link)->addr + ((*link)->pages + 1) * PAGE_SIZE;
+        link = &(*link)->next;
+    }
+    if (addr + (pages + 1) * PAGE_SIZE > VMALLOC_END) {
+        return NULL;
+    }
+    
+    vmalloc_area_t* area = (vmalloc_area_t*)kmem_cache_alloc(vmalloc_area_cache);
+    if (!area) {
+        return NULL;
+    }
+    
+    if (!map_kernel_pages(addr, addr + pages * PAGE_SIZE)) {
+        kmem_cache_free(vmalloc_area_cache, area);
+        return NULL;
+    }
+    
+    area->addr = addr;
+    area->pages = pages;
+    area->next = *link;
+    *link = area;
+    memory_stats.vmalloc_pages += pages;
+    
+    return (void*)addr;
 }
 
+// 释放vmalloc分配的内存，逐页解除映射并归还页帧
 void vfree(void* ptr) {
-    kfree(ptr);
+    if (!ptr) {
+        return;
+    }
+    
+    vmalloc_area_t** link = &vmalloc_areas;
+    while (*link && (*link)->addr != (uint32_t)ptr) {
+        link = &(*link)->next;
+    }
+    vmalloc_area_t* area = *link;
+    if (!area) {
+        return;
+    }
+    
+    unmap_kernel_pages(area->addr, area->addr + area->pages * PAGE_SIZE);
+    memory_stats.vmalloc_pages -= area->pages;
+    *link = area->next;
+    kmem_cache_free(vmalloc_area_cache, area);
+}
+
+// 物理地址对应的页帧描述符
+page_t* phys_to_page(uint32_t page) {
+    return &page_descriptors[page / PAGE_SIZE];
+}
+
+// 页帧描述符对应的物理地址
+uint32_t page_to_phys(const page_t* desc) {
+    return (uint32_t)(desc - page_descriptors) * PAGE_SIZE;
 }
 
+// 位图仅作为调试视图，真正的分配状态由伙伴系统维护
 bool is_page_allocated(uint32_t page) {
     return get_bitmap_bit(page / PAGE_SIZE);
 }
@@ -548,45 +1611,845 @@ void mark_page_free(uint32_t page) {
     set_bitmap_bit(page / PAGE_SIZE, false);
 }
 
-// 内存上下文相关函数（简化实现）
+// 创建内存上下文：独立的页目录，共享内核部分的页表
 memory_context_t* create_memory_context(void) {
-    memory_context_t* ctx = (memory_context_t*)kmalloc(sizeof(memory_context_t));
-    if (ctx) {
-        ctx->page_dir = current_page_directory;
-        ctx->vm_areas = NULL;
-        ctx->heap_start = USER_SPACE_START;
-        ctx->heap_end = USER_SPACE_START + USER_SPACE_SIZE;
+    memory_context_t* ctx = (memory_context_t*)kmem_cache_alloc(memory_context_cache);
+    if (!ctx) {
+        return NULL;
+    }
+    
+    page_directory_t* pd = (page_directory_t*)alloc_zeroed_page();
+    if (!pd) {
+        kmem_cache_free(memory_context_cache, ctx);
+        return NULL;
+    }
+    
+    // 用户空间之外的目录项直接引用内核页表，内核映射在所有上下文中一致
+    uint32_t user_first = get_page_directory_index(USER_SPACE_START);
+    uint32_t user_last = get_page_directory_index(USER_STACK_TOP - 1);
+    for (uint32_t i = 0; i < PAGE_DIRECTORY_SIZE; i++) {
+        if (i < user_first || i > user_last) {
+            pd->entries[i] = kernel_page_directory->entries[i];
+        }
     }
+    
+    ctx->page_dir = pd;
+    ctx->vm_areas = NULL;
+    ctx->page_tables = 0;
+    ctx->heap_start = USER_SPACE_START;
+    ctx->heap_end = USER_SPACE_START;
     return ctx;
 }
 
+// 复制内存上下文（fork）：共享所有已分配的页面，可写页面在双方都改为只读写时复制
+memory_context_t* clone_memory_context(memory_context_t* parent) {
+    if (!parent) {
+        return NULL;
+    }
+    
+    memory_context_t* child = create_memory_context();
+    if (!child) {
+        return NULL;
+    }
+    child->heap_start = parent->heap_start;
+    child->heap_end = parent->heap_end;
+    
+    // 复制区域描述符，保持原有顺序
+    vm_area_t** tail = &child->vm_areas;
+    for (vm_area_t* area = parent->vm_areas; area; area = area->next) {
+        vm_area_t* copy = alloc_vm_area(area->start, area->end, area->flags,
+                                        area->file, area->file_offset);
+        if (!copy) {
+            destroy_memory_context(child);
+            return NULL;
+        }
+        *tail = copy;
+        tail = &copy->next;
+    }
+    
+    // 只遍历存在的页表，代价与页表数量成正比，而不是与已分配的内存成正比
+    uint32_t user_first = get_page_directory_index(USER_SPACE_START);
+    uint32_t user_last = get_page_directory_index(USER_STACK_TOP - 1);
+    for (uint32_t pd_index = user_first; pd_index <= user_last; pd_index++) {
+        if (!parent->page_dir->entries[pd_index].present) {
+            continue;
+        }
+        
+        page_table_t* pt = (page_table_t*)(parent->page_dir->entries[pd_index].address << 12);
+        for (uint32_t pt_index = 0; pt_index < PAGE_TABLE_SIZE; pt_index++) {
+            page_entry_t* entry = &pt->entries[pt_index];
+            uint32_t virtual_addr = (pd_index << 22) | (pt_index << 12);
+            
+            // 读页表项到增加引用之间不能被抢占，否则后台回收可能把页面换出并释放页帧
+            uint32_t irq_flags = irq_save();
+            
+            // 换出的页面：子进程共享同一个槽位，谁先换入谁得到私有副本
+            if (is_swap_entry(entry)) {
+                uint32_t slot = entry->address;
+                if (!map_user_page(child, virtual_addr, slot << 12, PAGE_USER | PAGE_SWAPPED)) {
+                    irq_restore(irq_flags);
+                    destroy_memory_context(child);
+                    return NULL;
+                }
+                swap_dup_slot(slot);
+                irq_restore(irq_flags);
+                continue;
+            }
+            if (!entry->present) {
+                irq_restore(irq_flags);
+                continue;
+            }
+            
+            if (entry->rw) {
+                entry->rw = 0;
+                entry->available = 1;
+            }
+            
+            // 先增加引用：map_user_page分配页表时可能直接回收，共享的页面不会被选中
+            uint32_t page = entry->address << 12;
+            page_descriptors[entry->address].ref_count++;
+            
+            uint32_t flags = PAGE_PRESENT | PAGE_USER | (entry->available ? PAGE_COW : 0);
+            if (!map_user_page(child, virtual_addr, page, flags)) {
+                put_user_page(child, page);
+                irq_restore(irq_flags);
+                destroy_memory_context(child);
+                return NULL;
+            }
+            irq_restore(irq_flags);
+        }
+    }
+    
+    // 父进程的可写页面刚被改为只读，必须刷新它的TLB
+    if (parent == current_memory_context) {
+        invalidate_tlb();
+    }
+    
+    return child;
+}
+
+// 销毁内存上下文，释放所有已经分配的用户页面
 void destroy_memory_context(memory_context_t* ctx) {
-    if (ctx) {
-        kfree(ctx);
+    if (!ctx) {
+        return;
     }
+    
+    if (ctx == current_memory_context) {
+        switch_memory_context(NULL);
+    }
+    
+    while (ctx->vm_areas) {
+        vm_area_t* area = ctx->vm_areas;
+        ctx->vm_areas = area->next;
+        release_user_pages(ctx, area->start, area->end);
+        free_vm_area(area);
+    }
+    
+    release_page_tables(ctx);
+    free_physical_page((uint32_t)ctx->page_dir);
+    kmem_cache_free(memory_context_cache, ctx);
 }
 
+// 归还上下文的所有用户页表（内核部分的目录项与内核页目录共享，不能释放）
+static void release_page_tables(memory_context_t* ctx) {
+    uint32_t user_first = get_page_directory_index(USER_SPACE_START);
+    uint32_t user_last = get_page_directory_index(USER_STACK_TOP - 1);
+    
+    for (uint32_t pd_index = user_first; pd_index <= user_last && ctx->page_tables; pd_index++) {
+        page_entry_t* pde = &ctx->page_dir->entries[pd_index];
+        if (!pde->present) {
+            continue;
+        }
+        
+        destroy_page_table((page_table_t*)(pde->address << 12));
+        memset(pde, 0, sizeof(page_entry_t));
+        ctx->page_tables--;
+    }
+}
+
+// 切换内存上下文（NULL表示内核上下文）
 void switch_memory_context(memory_context_t* ctx) {
-    if (ctx && ctx->page_dir) {
-        current_page_directory = ctx->page_dir;
+    page_directory_t* pd = ctx ? ctx->page_dir : kernel_page_directory;
+    
+    current_memory_context = ctx;
+    if (pd != current_page_directory) {
+        current_page_directory = pd;
         load_page_directory((uint32_t)current_page_directory);
     }
 }
 
+// 获取当前内存上下文
+memory_context_t* get_current_memory_context(void) {
+    return current_memory_context;
+}
+
+// 分配区域描述符，文件映射会复制一份私有的文件句柄
+static vm_area_t* alloc_vm_area(uint32_t start, uint32_t end, uint32_t flags,
+                                fs_file_t* file, uint32_t file_offset) {
+    vm_area_t* area = (vm_area_t*)kmem_cache_alloc(vm_area_cache);
+    if (!area) {
+        return NULL;
+    }
+    
+    area->start = start;
+    area->end = end;
+    area->flags = flags;
+    area->file = NULL;
+    area->file_offset = file_offset;
+    area->next = NULL;
+    
+    if (file) {
+        area->file = (fs_file_t*)kmalloc(sizeof(fs_file_t));
+        if (!area->file) {
+            kmem_cache_free(vm_area_cache, area);
+            return NULL;
+        }
+        *area->file = *file;
+    }
+    
+    return area;
+}
+
+// 释放区域描述符
+static void free_vm_area(vm_area_t* area) {
+    if (area->file) {
+        kfree(area->file);
+    }
+    kmem_cache_free(vm_area_cache, area);
+}
+
+// 插入区域；与相邻且标志相同的匿名区域合并
+static bool insert_vm_area(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                           fs_file_t* file, uint32_t file_offset) {
+    start &= ~(PAGE_SIZE - 1);
+    end = align_to_page(end);
+    if (start >= end || start < USER_SPACE_START || end > USER_STACK_TOP) {
+        return false;
+    }
+    
+    // 找到插入位置，并拒绝与已有区域重叠
+    vm_area_t* prev = NULL;
+    vm_area_t** link = &ctx->vm_areas;
+    while (*link && (*link)->start < end) {
+        if ((*link)->end > start) {
+            return false;
+        }
+        prev = *link;
+        link = &(*link)->next;
+    }
+    vm_area_t* next = *link;
+    
+    if (!file) {
+        bool merge_prev = prev && prev->end == start && prev->flags == flags && !prev->file;
+        bool merge_next = next && next->start == end && next->flags == flags && !next->file;
+        
+        if (merge_prev && merge_next) {
+            prev->end = next->end;
+            prev->next = next->next;
+            free_vm_area(next);
+            return true;
+        }
+        if (merge_prev) {
+            prev->end = end;
+            return true;
+        }
+        if (merge_next) {
+            next->start = start;
+            return true;
+        }
+    }
+    
+    vm_area_t* area = alloc_vm_area(start, end, flags, file, file_offset);
+    if (!area) {
+        return false;
+    }
+    area->next = next;
+    *link = area;
+    
+    return true;
+}
+
+// 登记一段匿名虚拟内存区域，页面在首次访问时由页故障处理程序分配并清零
 bool map_memory_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags) {
-    // 简化实现
-    (void)ctx;
-    (void)start;
-    (void)end;
-    (void)flags;
+    if (!ctx) {
+        return false;
+    }
+    return insert_vm_area(ctx, start, end, flags, NULL, 0);
+}
+
+// 登记一段文件映射区域（私有映射），页面在首次访问时从文件读入
+bool map_file_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                     fs_file_t* file, uint32_t offset) {
+    if (!ctx || !file || !file->valid || (offset & (PAGE_SIZE - 1))) {
+        return false;
+    }
+    return insert_vm_area(ctx, start, end, flags, file, offset);
+}
+
+// 在[start, end)位置建立新映射并替换其中原有的映射（MAP_FIXED）
+// 新区域和拆分旧区域要用的描述符都先分配好，全部成功后才取消旧映射，失败时原来的映射保持不变
+bool map_fixed_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                      fs_file_t* file, uint32_t offset) {
+    if (!ctx || (file && (!file->valid || (offset & (PAGE_SIZE - 1))))) {
+        return false;
+    }
+    
+    start &= ~(PAGE_SIZE - 1);
+    end = align_to_page(end);
+    if (start >= end || start < USER_SPACE_START || end > USER_STACK_TOP) {
+        return false;
+    }
+    
+    vm_area_t* area = alloc_vm_area(start, end, flags, file, offset);
+    if (!area) {
+        return false;
+    }
+    
+    vm_area_t* tail = NULL;
+    vm_area_t* split = find_split_area(ctx, start, end);
+    if (split) {
+        tail = alloc_vm_area(end, split->end, split->flags, split->file,
+                             split->file_offset + (end - split->start));
+        if (!tail) {
+            free_vm_area(area);
+            return false;
+        }
+    }
+    
+    remove_vm_range(ctx, start, end, tail);
+    
+    // 范围已经空出来，按地址顺序挂入链表
+    vm_area_t** link = &ctx->vm_areas;
+    while (*link && (*link)->start < start) {
+        link = &(*link)->next;
+    }
+    area->next = *link;
+    *link = area;
     return true;
 }
 
+// 取消[start, end)范围内的映射，部分覆盖的区域会被截断或拆分
 bool unmap_memory_region(memory_context_t* ctx, uint32_t start, uint32_t end) {
-    // 简化实现
-    (void)ctx;
-    (void)start;
-    (void)end;
+    if (!ctx) {
+        return false;
+    }
+    
+    start &= ~(PAGE_SIZE - 1);
+    end = align_to_page(end);
+    if (start >= end) {
+        return false;
+    }
+    
+    // 拆分需要的描述符先分配，分配失败时不做任何修改
+    vm_area_t* tail = NULL;
+    vm_area_t* split = find_split_area(ctx, start, end);
+    if (split) {
+        tail = alloc_vm_area(end, split->end, split->flags, split->file,
+                             split->file_offset + (end - split->start));
+        if (!tail) {
+            return false;
+        }
+    }
+    
+    remove_vm_range(ctx, start, end, tail);
+    return true;
+}
+
+// 完全包含[start, end)且两端都有剩余的区域，取消映射时要拆成两个
+static vm_area_t* find_split_area(memory_context_t* ctx, uint32_t start, uint32_t end) {
+    vm_area_t* area = find_vm_area(ctx, start);
+    if (area && area->start < start && area->end > end) {
+        return area;
+    }
+    return NULL;
+}
+
+// 从区域链表中去掉[start, end)并释放其中的页面；需要拆分时tail是预先分配的后半段
+static void remove_vm_range(memory_context_t* ctx, uint32_t start, uint32_t end, vm_area_t* tail) {
+    vm_area_t** link = &ctx->vm_areas;
+    while (*link && (*link)->start < end) {
+        vm_area_t* area = *link;
+        if (area->end <= start) {
+            link = &area->next;
+            continue;
+        }
+        
+        // 中间一段被取消：拆成两个区域
+        if (area->start < start && area->end > end) {
+            tail->next = area->next;
+            area->next = tail;
+            area->end = start;
+            release_user_pages(ctx, start, end);
+            return;
+        }
+        
+        uint32_t cut_start = area->start > start ? area->start : start;
+        uint32_t cut_end = area->end < end ? area->end : end;
+        release_user_pages(ctx, cut_start, cut_end);
+        
+        if (cut_start == area->start && cut_end == area->end) {
+            *link = area->next;
+            free_vm_area(area);
+        } else if (cut_start == area->start) {
+            area->file_offset += cut_end - area->start;
+            area->start = cut_end;
+            link = &area->next;
+        } else {
+            area->end = cut_start;
+            link = &area->next;
+        }
+    }
+}
+
+// 移动用户堆的末尾：增长时登记新的按需分配区域（与原堆区域合并），收缩时释放多出的整页
+bool set_program_break(memory_context_t* ctx, uint32_t new_end) {
+    if (!ctx || new_end < ctx->heap_start || new_end > USER_MMAP_BASE) {
+        return false;
+    }
+    
+    uint32_t old_limit = align_to_page(ctx->heap_end);
+    uint32_t new_limit = align_to_page(new_end);
+    
+    if (new_limit > old_limit) {
+        if (!map_memory_region(ctx, old_limit, new_limit, VM_READ | VM_WRITE | VM_HEAP)) {
+            return false;
+        }
+    } else if (new_limit < old_limit) {
+        if (!unmap_memory_region(ctx, new_limit, old_limit)) {
+            return false;
+        }
+    }
+    
+    ctx->heap_end = new_end;
+    return true;
+}
+
+// 在mmap区域中为length字节查找第一个足够大的空闲地址范围
+uint32_t find_unmapped_region(memory_context_t* ctx, uint32_t length) {
+    if (!ctx || length == 0) {
+        return 0;
+    }
+    
+    length = align_to_page(length);
+    uint32_t candidate = USER_MMAP_BASE;
+    for (vm_area_t* area = ctx->vm_areas; area; area = area->next) {
+        if (area->end <= candidate) {
+            continue;
+        }
+        if (area->start >= candidate + length) {
+            break;
+        }
+        candidate = area->end;
+    }
+    
+    if (candidate + length > USER_STACK_TOP || candidate + length < candidate) {
+        return 0;
+    }
+    return candidate;
+}
+
+// 查找包含地址的区域
+static vm_area_t* find_vm_area(memory_context_t* ctx, uint32_t addr) {
+    for (vm_area_t* area = ctx->vm_areas; area && area->start <= addr; area = area->next) {
+        if (addr < area->end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+// 释放[start, end)中已经分配的页面
+static void release_user_pages(memory_context_t* ctx, uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        // 读取、释放和清除页表项要一次完成，中途被抢占的话回收可能已把它改成交换项并释放页帧
+        uint32_t flags = irq_save();
+        page_entry_t* entry = get_page_entry(ctx->page_dir, addr, false);
+        if (!entry) {
+            // 整个页表都不存在，跳到下一个4MB边界
+            addr = (addr & ~0x3FFFFF) + 0x400000 - PAGE_SIZE;
+            irq_restore(flags);
+            continue;
+        }
+        if (is_swap_entry(entry)) {
+            swap_free_slot(entry->address);
+            memset(entry, 0, sizeof(page_entry_t));
+        } else if (entry->present) {
+            put_user_page(ctx, entry->address << 12);
+            memset(entry, 0, sizeof(page_entry_t));
+            
+            if (ctx == current_memory_context) {
+                invalidate_page(addr);
+            }
+        }
+        irq_restore(flags);
+    }
+}
+
+// 登记一个刚映射进用户地址空间的新页帧，记录反向映射并放入活跃链表
+static void install_user_page(memory_context_t* ctx, uint32_t virtual_addr, uint32_t page) {
+    uint32_t flags = irq_save();
+    page_t* desc = phys_to_page(page);
+    desc->ref_count = 1;
+    desc->flags |= PG_USER;
+    desc->mapping = ctx;
+    desc->mapping_addr = virtual_addr;
+    lru_add(desc, LRU_ACTIVE);
+    memory_stats.user_memory += PAGE_SIZE;
+    irq_restore(flags);
+}
+
+// 释放ctx对一个用户页帧的引用，最后一个引用释放时归还页帧
+// 引用计数和LRU状态要一起检查和修改，期间不能被回收扫描抢占
+static void put_user_page(memory_context_t* ctx, uint32_t page) {
+    uint32_t flags = irq_save();
+    page_t* desc = phys_to_page(page);
+    if (desc->mapping == ctx) {
+        desc->mapping = NULL;        // 剩下的持有者未知，回收扫描会跳过它
+    }
+    if (desc->ref_count > 1) {
+        desc->ref_count--;
+        irq_restore(flags);
+        return;
+    }
+    
+    if (desc->flags & PG_LRU) {
+        lru_del(desc);
+    }
+    desc->ref_count = 0;
+    desc->flags &= ~(PG_USER | PG_SWAPBACKED);
+    free_physical_page(page);
+    memory_stats.user_memory -= PAGE_SIZE;
+    irq_restore(flags);
+}
+
+// 插入链表头部（最近使用的一端）；调用者负责关中断（install_user_page、put_user_page和回收路径）
+static void lru_add(page_t* desc, uint32_t list) {
+    page_t* head = lru_lists[list];
+    if (head) {
+        desc->lru_next = head;
+        desc->lru_prev = head->lru_prev;
+        head->lru_prev->lru_next = desc;
+        head->lru_prev = desc;
+    } else {
+        desc->lru_next = desc;
+        desc->lru_prev = desc;
+    }
+    lru_lists[list] = desc;
+    
+    desc->flags |= PG_LRU;
+    if (list == LRU_ACTIVE) {
+        desc->flags |= PG_ACTIVE;
+    }
+    memory_stats.lru_pages[list]++;
+}
+
+// 从所在的LRU链表中摘除
+static void lru_del(page_t* desc) {
+    uint32_t list = (desc->flags & PG_ACTIVE) ? LRU_ACTIVE : LRU_INACTIVE;
+    
+    if (desc->lru_next == desc) {
+        lru_lists[list] = NULL;
+    } else {
+        desc->lru_prev->lru_next = desc->lru_next;
+        desc->lru_next->lru_prev = desc->lru_prev;
+        if (lru_lists[list] == desc) {
+            lru_lists[list] = desc->lru_next;
+        }
+    }
+    
+    desc->lru_next = NULL;
+    desc->lru_prev = NULL;
+    desc->flags &= ~(PG_LRU | PG_ACTIVE);
+    memory_stats.lru_pages[list]--;
+}
+
+// 通过反向映射找到映射该页的页表项；映射已经改变时返回NULL
+static page_entry_t* page_mapping_entry(page_t* desc) {
+    if (!desc->mapping || desc->ref_count != 1) {
+        return NULL;
+    }
+    
+    page_entry_t* entry = get_page_entry(desc->mapping->page_dir, desc->mapping_addr, false);
+    if (!entry || !entry->present || entry->address != (uint32_t)(desc - page_descriptors)) {
+        return NULL;
+    }
+    return entry;
+}
+
+// 尝试释放一个最近未被访问的页面：未修改过的文件页直接丢弃，缺页时会从文件重新读入；
+// 其他页面写到交换区，页表项改为记录槽号
+static bool try_reclaim_page(page_t* desc, page_entry_t* entry) {
+    vm_area_t* area = find_vm_area(desc->mapping, desc->mapping_addr);
+    if (!area) {
+        return false;
+    }
+    
+    memory_context_t* ctx = desc->mapping;
+    uint32_t virtual_addr = desc->mapping_addr;
+    uint32_t page = page_to_phys(desc);
+    
+    // 只有从未改写过的文件页才能丢弃：换入时页表项的脏位是清零的，靠PG_SWAPBACKED记住已经改写过
+    if (area->file && !entry->dirty && !(desc->flags & PG_SWAPBACKED)) {
+        memset(entry, 0, sizeof(page_entry_t));
+    } else {
+        uint32_t slot = swap_out((void*)page);
+        if (slot == SWAP_NO_SLOT) {
+            return false;
+        }
+        
+        memset(entry, 0, sizeof(page_entry_t));
+        entry->address = slot;
+        entry->user = 1;
+        entry->available = 2;        // PAGE_SWAPPED
+    }
+    
+    if (ctx == current_memory_context) {
+        invalidate_page(virtual_addr);
+    }
+    put_user_page(ctx, page);
+    return true;
+}
+
+// 不存在且带PAGE_SWAPPED标记的页表项保存的是交换槽号
+static bool is_swap_entry(const page_entry_t* entry) {
+    return !entry->present && (entry->available & 2);
+}
+
+// 把一个换出的页面读回新的页帧并重新映射，释放本上下文对槽位的引用
+static bool swap_in_page(memory_context_t* ctx, vm_area_t* area, uint32_t page_addr, page_entry_t* entry) {
+    uint32_t slot = entry->address;
+    uint32_t page = alloc_physical_page();
+    if (!page) {
+        return false;
+    }
+    if (!swap_read_page(slot, (void*)page)) {
+        free_physical_page(page);
+        return false;
+    }
+    
+    uint32_t flags = PAGE_PRESENT | PAGE_USER;
+    if (area->flags & VM_WRITE) {
+        flags |= PAGE_WRITABLE;
+    }
+    if (!map_user_page(ctx, page_addr, page, flags)) {
+        free_physical_page(page);
+        return false;
+    }
+    
+    swap_free_slot(slot);
+    install_user_page(ctx, page_addr, page);
+    phys_to_page(page)->flags |= PG_SWAPBACKED;  // 交换区里的内容才是最新的，不能再从文件读回
+    return true;
+}
+
+// 时钟式扫描：从链表尾部取页，访问位置位的页清除访问位后放回活跃链表头部（第二次机会），
+// 活跃链表中未访问的页降级到非活跃链表，非活跃链表中未访问的页尝试释放
+static uint32_t shrink_lru_list(uint32_t list, uint32_t nr_to_scan, uint32_t target) {
+    uint32_t freed = 0;
+    
+    while (nr_to_scan-- > 0 && lru_lists[list] && freed < target) {
+        page_t* desc = lru_lists[list]->lru_prev;
+        page_entry_t* entry = page_mapping_entry(desc);
+        memory_stats.reclaim_scanned++;
+        
+        lru_del(desc);
+        
+        // 共享页或映射未知的页无法检查访问位，当作活跃页
+        if (!entry || entry->accessed) {
+            if (entry) {
+                entry->accessed = 0;
+                if (desc->mapping == current_memory_context) {
+                    invalidate_page(desc->mapping_addr);
+                }
+            }
+            lru_add(desc, LRU_ACTIVE);
+            continue;
+        }
+        
+        if (list == LRU_ACTIVE) {
+            lru_add(desc, LRU_INACTIVE);
+        } else if (try_reclaim_page(desc, entry)) {
+            freed++;
+        } else {
+            lru_add(desc, LRU_INACTIVE);
+        }
+    }
+    return freed;
+}
+
+// 把页表回收池中的页帧全部还给伙伴系统
+static uint32_t drain_page_table_pool(void) {
+    uint32_t freed = 0;
+    
+    while (page_table_pool) {
+        buddy_block_t* node = page_table_pool;
+        page_table_pool = node->next;
+        phys_to_page((uint32_t)node)->flags &= ~PG_PAGE_TABLE;
+        free_physical_page((uint32_t)node);
+        memory_stats.page_table_pool_pages--;
+        freed++;
+    }
+    return freed;
+}
+
+// 回收至少target个页帧（尽力而为），返回实际释放的页数
+// 先丢弃代价最小的缓存（页表池、空slab），不够再扫描LRU链表
+uint32_t reclaim_pages(uint32_t target) {
+    uint32_t flags = irq_save();
+    if (reclaim_running) {
+        irq_restore(flags);
+        return 0;
+    }
+    reclaim_running = true;
+    
+    uint32_t freed = drain_page_table_pool();
+    freed += kmem_shrink_all();
+    
+    if (target < RECLAIM_BATCH) {
+        target = RECLAIM_BATCH;
+    }
+    
+    // 每轮先让非活跃链表至少和活跃链表一样长，再从非活跃链表释放；最多扫描两遍全部页面
+    for (uint32_t pass = 0; pass < 2 && freed < target; pass++) {
+        uint32_t active = memory_stats.lru_pages[LRU_ACTIVE];
+        uint32_t inactive = memory_stats.lru_pages[LRU_INACTIVE];
+        if (active > inactive) {
+            shrink_lru_list(LRU_ACTIVE, active - inactive, active);
+        }
+        freed += shrink_lru_list(LRU_INACTIVE, memory_stats.lru_pages[LRU_INACTIVE], target - freed);
+    }
+    
+    memory_stats.reclaimed_pages += freed;
+    reclaim_running = false;
+    irq_restore(flags);
+    return freed;
+}
+
+// 后台回收（由空闲进程调用）：空闲页低于low水位时回收到high水位，返回释放的页数
+uint32_t balance_memory(void) {
+    if (buddy_free_pages >= watermark_low) {
+        return 0;
+    }
+    return reclaim_pages(watermark_high - buddy_free_pages);
+}
+
+// 写时复制：页面仍被共享时复制一份，否则直接恢复写权限
+static bool handle_cow_fault(memory_context_t* ctx, uint32_t fault_addr) {
+    page_entry_t* entry = get_page_entry(ctx->page_dir, fault_addr, false);
+    if (!entry || !entry->present || !entry->available) {
+        return false;
+    }
+    
+    uint32_t old_page = entry->address << 12;
+    if (page_descriptors[entry->address].ref_count > 1) {
+        uint32_t new_page = alloc_physical_page();
+        if (!new_page) {
+            return false;
+        }
+        memcpy((void*)new_page, (void*)old_page, PAGE_SIZE);
+        install_user_page(ctx, fault_addr & ~(PAGE_SIZE - 1), new_page);
+        phys_to_page(new_page)->flags |= PG_SWAPBACKED;  // 私有副本，回收时写交换区
+        
+        put_user_page(ctx, old_page);
+        entry->address = new_page >> 12;
+    } else {
+        // 其他持有者都已释放，当前上下文重新成为反向映射的主人
+        page_descriptors[entry->address].mapping = ctx;
+        page_descriptors[entry->address].mapping_addr = fault_addr & ~(PAGE_SIZE - 1);
+    }
+    
+    entry->rw = 1;
+    entry->available = 0;
+    invalidate_page(fault_addr & ~(PAGE_SIZE - 1));
+    
+    memory_stats.cow_faults++;
+    return true;
+}
+
+// 从文件读入一页内容（直接读到页帧中，文件末尾之后保持为0）
+static void fill_file_page(vm_area_t* area, uint32_t page_addr, uint32_t page) {
+    uint32_t offset = area->file_offset + (page_addr - area->start);
+    if (offset >= area->file->size) {
+        return;
+    }
+    
+    uint32_t length = area->file->size - offset;
+    if (length > PAGE_SIZE) {
+        length = PAGE_SIZE;
+    }
+    
+    if (fs_seek(area->file, offset, 0) == FS_SUCCESS) {
+        fs_read(area->file, (void*)page, length);
+    }
+}
+
+// 页故障处理：在当前上下文的区域中按需分配并清零页面，或处理写时复制
+bool handle_page_fault(uint32_t fault_addr, uint32_t error_code) {
+    memory_stats.page_faults++;
+    
+    memory_context_t* ctx = current_memory_context;
+    if (!ctx) {
+        return false;
+    }
+    
+    if (error_code & PAGE_FAULT_PRESENT) {
+        if (!(error_code & PAGE_FAULT_WRITE)) {
+            return false;
+        }
+        return handle_cow_fault(ctx, fault_addr);
+    }
+    
+    vm_area_t* area = find_vm_area(ctx, fault_addr);
+    if (!area) {
+        return false;
+    }
+    if ((error_code & PAGE_FAULT_WRITE) && !(area->flags & VM_WRITE)) {
+        return false;
+    }
+    
+    // 换出的页面：读回缺页的一页，再顺带读回换出时落在相邻槽位的后续页面
+    uint32_t page_addr = fault_addr & ~(PAGE_SIZE - 1);
+    page_entry_t* entry = get_page_entry(ctx->page_dir, page_addr, false);
+    if (entry && is_swap_entry(entry)) {
+        uint32_t slot = entry->address;
+        if (!swap_in_page(ctx, area, page_addr, entry)) {
+            return false;
+        }
+        
+        for (uint32_t i = 1; i < SWAP_READAHEAD && buddy_free_pages > watermark_low; i++) {
+            uint32_t next_addr = page_addr + i * PAGE_SIZE;
+            if (next_addr >= area->end) {
+                break;
+            }
+            
+            page_entry_t* next = get_page_entry(ctx->page_dir, next_addr, false);
+            if (!next || !is_swap_entry(next) || next->address != slot + i ||
+                !swap_in_page(ctx, area, next_addr, next)) {
+                break;
+            }
+            swap_count_readahead();
+        }
+        return true;
+    }
+    
+    uint32_t page = alloc_zeroed_page();
+    if (!page) {
+        return false;
+    }
+    if (area->file) {
+        fill_file_page(area, page_addr, page);
+    }
+    
+    uint32_t flags = PAGE_PRESENT | PAGE_USER;
+    if (area->flags & VM_WRITE) {
+        flags |= PAGE_WRITABLE;
+    }
+    if (!map_user_page(ctx, page_addr, page, flags)) {
+        free_physical_page(page);
+        return false;
+    }
+    
+    install_user_page(ctx, page_addr, page);
     return true;
 }
 
@@ -606,6 +2469,7 @@ void print_page_directory(page_directory_t* pd) {
             vga_putstr(" (");
             vga_putstr(pd->entries[i].user ? "U" : "K");
             vga_putstr(pd->entries[i].rw ? "W" : "R");
+            vga_putstr(pd->entries[i].size ? " 4M" : "");
             vga_putstr(")\n");
         }
     }
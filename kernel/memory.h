@@ -4,16 +4,38 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "../fs/filesystem.h"
+#include "memprof.h"
 
 // 内存管理常量
 #define PAGE_SIZE 4096
+#define LARGE_PAGE_SIZE 0x400000    // PSE大页：一个页目录项映射4MB
 #define PAGE_DIRECTORY_SIZE 1024
 #define PAGE_TABLE_SIZE 1024
 #define KERNEL_START 0x100000  // 1MB
-#define KERNEL_HEAP_START 0x200000  // 2MB
-#define KERNEL_HEAP_SIZE 0x100000   // 1MB heap
-#define USER_SPACE_START 0x400000   // 4MB
-#define USER_SPACE_SIZE 0x3C00000   // 60MB user space
+#define USER_SPACE_START 0xC0000000 // 低端虚拟地址留给物理内存的身份映射
+#define USER_SPACE_SIZE 0x30000000  // 768MB user space
+#define USER_STACK_TOP (USER_SPACE_START + USER_SPACE_SIZE)
+#define USER_MMAP_BASE (USER_SPACE_START + 0x10000000) // mmap从这里开始查找空闲区域
+#define VMALLOC_START USER_STACK_TOP  // vmalloc区域紧跟在用户空间之后
+#define VMALLOC_SIZE 0x4000000        // 64MB，页表在启动时建好并被所有上下文共享
+#define VMALLOC_END (VMALLOC_START + VMALLOC_SIZE)
+#define KERNEL_HEAP_START VMALLOC_END     // 内核堆位于vmalloc区域之后的独立虚拟窗口
+#define KERNEL_HEAP_SIZE 0x100000         // 初始映射1MB
+#define KERNEL_HEAP_MAX_SIZE 0x4000000    // 按需增长，最多64MB
+
+// BIOS E820内存图（由引导扇区收集后传给内核）
+#define E820_MAX_ENTRIES 32
+#define E820_TYPE_USABLE 1
+
+// 伙伴系统常量
+#define BUDDY_MAX_ORDER 10          // 最大阶：2^10页 = 4MB连续物理内存
+
+// 物理内存区域：ISA DMA只能访问16MB以下的内存
+#define ZONE_DMA 0
+#define ZONE_NORMAL 1
+#define ZONE_COUNT 2
+#define ZONE_DMA_LIMIT 0x1000000
 
 // 页表项标志位
 #define PAGE_PRESENT 0x1
@@ -25,6 +47,20 @@
 #define PAGE_DIRTY 0x40
 #define PAGE_SIZE_4MB 0x80
 #define PAGE_GLOBAL 0x100
+#define PAGE_COW 0x200              // 软件可用位：写时复制页面
+#define PAGE_SWAPPED 0x400          // 软件可用位：页面已换出（不存在），地址字段保存交换槽号
+
+// 页故障错误码
+#define PAGE_FAULT_PRESENT 0x1      // 访问的页面存在（保护违例）
+#define PAGE_FAULT_WRITE 0x2        // 写访问
+#define PAGE_FAULT_USER 0x4         // 用户态访问
+
+// 虚拟内存区域标志
+#define VM_READ 0x1
+#define VM_WRITE 0x2
+#define VM_EXEC 0x4
+#define VM_STACK 0x8
+#define VM_HEAP 0x10
 
 // 内存区域类型
 typedef enum {
@@ -34,15 +70,72 @@ typedef enum {
     MEMORY_KERNEL
 } memory_type_t;
 
-// 内存块结构
+// E820内存区域描述（与BIOS返回的24字节格式一致）
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi_attributes;
+} __attribute__((packed)) e820_entry_t;
+
+typedef struct {
+    uint32_t count;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_map_t;
+
+// 堆块头部（头尾边界标记，尾部只保存块大小）
 typedef struct memory_block {
-    uint32_t start_addr;
-    uint32_t size;
-    memory_type_t type;
-    struct memory_block* next;
+    uint32_t size;                   // 块总大小（含头部和尾部标记）
+    memory_type_t type;              // 块状态
+#ifdef CONFIG_MEMPROF
+    memprof_tag_t tag;               // 分配调用点，紧贴在数据区之前
+#endif
+    struct memory_block* next;       // 空闲链表指针（仅空闲块有效，与数据区重叠）
     struct memory_block* prev;
 } memory_block_t;
 
+#define HEAP_ALIGN 8
+#define HEAP_BLOCK_HEADER_SIZE offsetof(memory_block_t, next)
+#define HEAP_BLOCK_FOOTER_SIZE sizeof(uint32_t)
+#define HEAP_BLOCK_OVERHEAD (HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_FOOTER_SIZE)
+#define HEAP_MIN_BLOCK_SIZE ((sizeof(memory_block_t) + HEAP_BLOCK_FOOTER_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1))
+
+// slab对象前为分析器标签预留的空间
+#ifdef CONFIG_MEMPROF
+#define KMALLOC_TAG_SIZE sizeof(memprof_tag_t)
+#else
+#define KMALLOC_TAG_SIZE 0
+#endif
+
+// 页帧描述符标志
+#define PG_RESERVED 0x1             // 固件保留、内存空洞或内核占用，永远不交给分配器
+#define PG_USER 0x2                 // 映射在用户地址空间中的页面
+#define PG_PAGE_TABLE 0x4           // 用作页表
+#define PG_ZEROED 0x8               // 位于预清零池中
+#define PG_LRU 0x10                 // 位于LRU链表中
+#define PG_ACTIVE 0x20              // 位于活跃链表（否则为非活跃链表）
+#define PG_SWAPBACKED 0x40          // 内容已与映射的文件不同（换出过），回收时不能直接丢弃
+
+// 页面回收
+#define LRU_ACTIVE 0
+#define LRU_INACTIVE 1
+#define LRU_COUNT 2
+#define WATERMARK_MIN_PAGES 32      // min水位的下限；实际水位按物理页数的1/128计算
+#define RECLAIM_BATCH 32            // 直接回收一次至少尝试回收的页数
+
+struct memory_context;
+
+// 页帧描述符：每个物理页帧一个，按页帧号索引，启动时按检测到的内存大小一次性分配
+typedef struct page {
+    uint16_t ref_count;              // 映射该页帧的地址空间数
+    uint8_t order;                   // 空闲块头部的阶，不是空闲块头部时为0xFF
+    uint8_t flags;                   // PG_*标志
+    struct page* lru_next;           // LRU链表（页面回收使用）
+    struct page* lru_prev;
+    struct memory_context* mapping;  // 反向映射：独占该页的上下文，共享或未知时为NULL
+    uint32_t mapping_addr;           // 该页在mapping中的虚拟地址
+} page_t;
+
 // 页表项结构
 typedef struct {
     uint32_t present : 1;
@@ -68,23 +161,36 @@ typedef struct {
     page_entry_t entries[PAGE_DIRECTORY_SIZE];
 } page_directory_t;
 
-// 虚拟内存区域
+// 虚拟内存区域（页面在首次访问时才分配）
 typedef struct vm_area {
     uint32_t start;
     uint32_t end;
     uint32_t flags;
-    struct vm_area* next;
+    fs_file_t* file;                 // 文件映射时为区域私有的文件句柄，匿名映射为NULL
+    uint32_t file_offset;            // start处对应的文件偏移
+    struct vm_area* next;            // 按起始地址排序
 } vm_area_t;
 
+// vmalloc区域描述（按起始地址排序）
+typedef struct vmalloc_area {
+    uint32_t addr;
+    uint32_t pages;                  // 映射的页数（不含末尾的保护页）
+    struct vmalloc_area* next;
+} vmalloc_area_t;
+
 // 进程内存上下文
-typedef struct {
+typedef struct memory_context {
     page_directory_t* page_dir;
     vm_area_t* vm_areas;
+    uint32_t page_tables;            // 该上下文拥有的用户页表数
     uint32_t heap_start;
     uint32_t heap_end;
 } memory_context_t;
 
-// 内存统计信息
+// 统计用的大小级别：kmalloc-8 ~ kmalloc-1024，最后一级为大块堆分配
+#define MEMORY_SIZE_CLASSES 9
+
+// 内存统计信息（在每次分配/释放时增量维护）
 typedef struct {
     uint32_t total_memory;
     uint32_t free_memory;
@@ -92,14 +198,30 @@ typedef struct {
     uint32_t kernel_memory;
     uint32_t user_memory;
     uint32_t page_faults;
+    uint32_t cow_faults;                        // 写时复制处理的写故障次数
     uint32_t page_allocations;
     uint32_t page_deallocations;
+    uint32_t peak_used_memory;                  // used_memory的历史最高值
+    uint32_t heap_free_memory;                  // 堆中空闲块的总字节数
+    uint32_t heap_size;                         // 堆当前映射的字节数
+    uint32_t page_table_pages;                  // 正在使用的页表页帧数
+    uint32_t page_table_pool_pages;             // 回收池中缓存的页表页帧数
+    uint32_t zero_pool_pages;                   // 预清零池中的页帧数
+    uint32_t zero_pool_hits;                    // alloc_zeroed_page直接从池中取到页面的次数
+    uint32_t zero_pool_misses;                  // 池空时同步清零的次数
+    uint32_t vmalloc_pages;                     // vmalloc映射的页数
+    uint32_t lru_pages[LRU_COUNT];              // 活跃/非活跃LRU链表中的页数
+    uint32_t reclaim_scanned;                   // 回收扫描过的LRU页数
+    uint32_t reclaimed_pages;                   // 回收释放的页数（含页表池和空slab）
+    uint32_t direct_reclaims;                   // 分配路径上同步回收的次数
+    uint32_t class_allocations[MEMORY_SIZE_CLASSES]; // 每个大小级别的累计分配次数
+    uint32_t class_live[MEMORY_SIZE_CLASSES];        // 每个大小级别当前存活的分配数
 } memory_stats_t;
 
 // 函数声明
 
 // 初始化函数
-void memory_init(void);
+void memory_init(const e820_map_t* map);
 void paging_init(void);
 void heap_init(void);
 
@@ -111,6 +233,8 @@ page_directory_t* get_current_page_directory(void);
 page_table_t* create_page_table(void);
 void destroy_page_table(page_table_t* pt);
 bool map_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags);
+bool map_large_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags);
+bool is_pse_enabled(void);
 bool unmap_page(uint32_t virtual_addr);
 uint32_t get_physical_address(uint32_t virtual_addr);
 void invalidate_tlb(void);
@@ -118,25 +242,47 @@ void invalidate_page(uint32_t virtual_addr);
 
 // 内存分配
 void* kmalloc(size_t size);
+void* kmalloc_aligned(size_t size, size_t align);
 void* kcalloc(size_t num, size_t size);
 void* krealloc(void* ptr, size_t size);
 void kfree(void* ptr);
+bool heap_expand(int32_t increment);
+void vmalloc_init(void);
 void* vmalloc(size_t size);
 void vfree(void* ptr);
 
 // 物理内存管理
 uint32_t alloc_physical_page(void);
+uint32_t alloc_zeroed_page(void);
+uint32_t refill_zeroed_pages(uint32_t max_pages);
+uint32_t reclaim_pages(uint32_t target);
+uint32_t balance_memory(void);
 void free_physical_page(uint32_t page);
+uint32_t alloc_physical_pages(uint32_t order);
+uint32_t alloc_pages_zone(uint32_t order, uint32_t zone);
+void free_physical_pages(uint32_t page, uint32_t order);
+uint32_t get_free_physical_pages(void);
+page_t* phys_to_page(uint32_t page);
+uint32_t page_to_phys(const page_t* desc);
 bool is_page_allocated(uint32_t page);
 void mark_page_allocated(uint32_t page);
 void mark_page_free(uint32_t page);
 
 // 虚拟内存管理
 memory_context_t* create_memory_context(void);
+memory_context_t* clone_memory_context(memory_context_t* parent);
 void destroy_memory_context(memory_context_t* ctx);
 void switch_memory_context(memory_context_t* ctx);
 bool map_memory_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags);
 bool unmap_memory_region(memory_context_t* ctx, uint32_t start, uint32_t end);
+bool map_file_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                     fs_file_t* file, uint32_t offset);
+bool map_fixed_region(memory_context_t* ctx, uint32_t start, uint32_t end, uint32_t flags,
+                      fs_file_t* file, uint32_t offset);
+uint32_t find_unmapped_region(memory_context_t* ctx, uint32_t length);
+bool set_program_break(memory_context_t* ctx, uint32_t new_end);
+memory_context_t* get_current_memory_context(void);
+bool handle_page_fault(uint32_t fault_addr, uint32_t error_code);
 
 // 内存信息
 memory_stats_t* get_memory_stats(void);
@@ -157,5 +303,7 @@ extern void enable_paging_asm(void);
 extern void disable_paging_asm(void);
 extern void invalidate_tlb_asm(void);
 extern void invalidate_page_asm(uint32_t virtual_addr);
+extern bool cpu_has_pse_asm(void);
+extern void enable_pse_asm(void);
 
 #endif // MEMORY_H
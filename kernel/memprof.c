@@ -0,0 +1,170 @@
+#include "memprof.h"
+#include "interrupt.h"
+#include "../drivers/vga/vga.h"
+#include "../lib/string.h"
+#include <stdbool.h>
+
+#ifdef CONFIG_MEMPROF
+
+// 调用点哈希表（开放寻址）；表满时新的调用点都记到caller为0的槽位
+static memprof_site_t memprof_sites[MEMPROF_MAX_SITES];
+static uint32_t memprof_site_count = 0;
+
+// 分配速率：按秒统计的窗口，previous_window_rate是上一个完整窗口的速率
+static uint32_t rate_window_start = 0;
+static uint32_t rate_window_count = 0;
+static uint32_t previous_window_rate = 0;
+static uint32_t total_allocations = 0;
+
+// 存活分配的平均时间戳：timestamp_sum是count个32位时间戳之和，所以高32位小于count，
+// 一条divl就能算出不超过32位的商，不需要libgcc的64位除法
+static uint32_t average_timestamp(uint64_t sum, uint32_t count) {
+    uint32_t quotient, remainder;
+    __asm__("divl %4"
+            : "=a"(quotient), "=d"(remainder)
+            : "a"((uint32_t)sum), "d"((uint32_t)(sum >> 32)), "rm"(count));
+    return quotient;
+}
+
+// 打印时的分配速率：当前窗口已满一秒（包括分配停止后窗口一直没有关闭的情况）就按它计算，
+// 否则用上一个窗口的速率，这样分配停止后速率会逐渐降到0，而不是停在最后一次分配时的值
+static uint32_t allocation_rate(uint32_t now) {
+    uint32_t elapsed = now - rate_window_start;
+    if (elapsed >= TIMER_HZ) {
+        return rate_window_count * TIMER_HZ / elapsed;
+    }
+    return previous_window_rate;
+}
+
+// 查找或创建调用点
+static memprof_site_t* memprof_site(uint32_t caller) {
+    uint32_t index = (caller >> 2) % MEMPROF_MAX_SITES;
+    
+    for (uint32_t probe = 0; probe < MEMPROF_MAX_SITES; probe++) {
+        memprof_site_t* site = &memprof_sites[(index + probe) % MEMPROF_MAX_SITES];
+        if (site->caller == caller) {
+            return site;
+        }
+        if (site->caller == 0 && site->total_count == 0) {
+            // 留一个槽位给溢出桶
+            if (caller != 0 && memprof_site_count >= MEMPROF_MAX_SITES - 1) {
+                break;
+            }
+            site->caller = caller;
+            memprof_site_count++;
+            return site;
+        }
+    }
+    
+    return caller ? memprof_site(0) : &memprof_sites[0];
+}
+
+// 记录一次分配：写入标签并累加调用点统计
+void memprof_record_alloc(memprof_tag_t* tag, uint32_t caller, uint32_t size) {
+    uint32_t now = timer_get_ticks();
+    
+    tag->caller = caller;
+    tag->timestamp = now;
+    
+    memprof_site_t* site = memprof_site(caller);
+    site->live_bytes += size;
+    site->live_count++;
+    site->total_count++;
+    site->timestamp_sum += now;
+    
+    total_allocations++;
+    if (now - rate_window_start >= TIMER_HZ) {
+        previous_window_rate = rate_window_count * TIMER_HZ / (now - rate_window_start);
+        rate_window_start = now;
+        rate_window_count = 0;
+    }
+    rate_window_count++;
+}
+
+// 记录一次释放：根据标签找到分配时的调用点
+void memprof_record_free(const memprof_tag_t* tag, uint32_t size) {
+    memprof_site_t* site = memprof_site(tag->caller);
+    if (site->live_count == 0) {
+        return;
+    }
+    
+    site->live_bytes -= size;
+    site->live_count--;
+    site->timestamp_sum -= tag->timestamp;
+}
+
+// 打印存活字节数最多的调用点
+void memprof_print(void) {
+    uint32_t now = timer_get_ticks();
+    bool printed[MEMPROF_MAX_SITES];
+    memset(printed, 0, sizeof(printed));
+    
+    vga_putstr("=== Kernel Allocation Profile ===\n");
+    vga_putstr("Allocations: ");
+    vga_puthex(total_allocations);
+    // 时钟没有运行时时间戳全为0，年龄和速率没有意义
+    vga_putstr("  Rate/s: ");
+    if (now) {
+        vga_puthex(allocation_rate(now));
+    } else {
+        vga_putstr("-");
+    }
+    vga_putstr("  Sites: ");
+    vga_puthex(memprof_site_count);
+    vga_putstr("\n");
+    vga_putstr("Caller      LiveBytes   Live        Total       AvgAge(ticks)\n");
+    
+    for (uint32_t n = 0; n < MEMPROF_PRINT_SITES; n++) {
+        memprof_site_t* best = NULL;
+        uint32_t best_index = 0;
+        for (uint32_t i = 0; i < MEMPROF_MAX_SITES; i++) {
+            memprof_site_t* site = &memprof_sites[i];
+            if (printed[i] || site->total_count == 0) {
+                continue;
+            }
+            if (!best || site->live_bytes > best->live_bytes) {
+                best = site;
+                best_index = i;
+            }
+        }
+        if (!best) {
+            break;
+        }
+        printed[best_index] = true;
+        
+        if (best->caller) {
+            vga_puthex(best->caller);
+        } else {
+            vga_putstr("(other)   ");
+        }
+        vga_putstr("  ");
+        vga_puthex(best->live_bytes);
+        vga_putstr("  ");
+        vga_puthex(best->live_count);
+        vga_putstr("  ");
+        vga_puthex(best->total_count);
+        vga_putstr("  ");
+        if (now) {
+            vga_puthex(best->live_count ? now - average_timestamp(best->timestamp_sum, best->live_count) : 0);
+        } else {
+            vga_putstr("-");
+        }
+        vga_putstr("\n");
+    }
+}
+
+#else
+
+void memprof_record_alloc(memprof_tag_t* tag, uint32_t caller, uint32_t size) {
+    (void)tag; (void)caller; (void)size;
+}
+
+void memprof_record_free(const memprof_tag_t* tag, uint32_t size) {
+    (void)tag; (void)size;
+}
+
+void memprof_print(void) {
+    vga_putstr("Allocation profiling is disabled (build with MEMPROF=1).\n");
+}
+
+#endif // CONFIG_MEMPROF
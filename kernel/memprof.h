@@ -0,0 +1,32 @@
+#ifndef MEMPROF_H
+#define MEMPROF_H
+
+#include <stdint.h>
+
+// 内核分配分析器：按调用点统计存活的字节数和分配次数
+// 只有定义了CONFIG_MEMPROF时才会在分配头部记录调用点（make MEMPROF=0可关闭）
+
+#define MEMPROF_MAX_SITES 64
+#define MEMPROF_PRINT_SITES 16
+
+// 每个分配记录的调用点和时间戳
+typedef struct {
+    uint32_t caller;                 // kmalloc等函数的返回地址
+    uint32_t timestamp;              // 分配时的时钟中断次数
+} memprof_tag_t;
+
+// 调用点统计
+typedef struct {
+    uint32_t caller;
+    uint32_t live_bytes;
+    uint32_t live_count;
+    uint32_t total_count;
+    uint64_t timestamp_sum;          // 存活分配的时间戳之和，用于计算平均存活时间（64位，长时间运行不溢出）
+} memprof_site_t;
+
+// 函数声明
+void memprof_record_alloc(memprof_tag_t* tag, uint32_t caller, uint32_t size);
+void memprof_record_free(const memprof_tag_t* tag, uint32_t size);
+void memprof_print(void);
+
+#endif // MEMPROF_H
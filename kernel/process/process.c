@@ -1,5 +1,6 @@
 #include "process.h"
 #include "../memory.h"
+#include "../interrupt.h"
 #include "../../drivers/vga/vga.h"
 #include "../../lib/string.h"
 #include <stddef.h>
@@ -11,14 +12,31 @@ static process_manager_t g_process_manager = {0};
 static pcb_t process_pool[MAX_PROCESSES];
 static uint8_t process_pool_used[MAX_PROCESSES];
 
+// 终止了自己的进程：它的内核栈直到切换走之后才能释放
+static pcb_t* zombie_process = NULL;
+static uint32_t zombie_esp;                // 切换离开已终止进程时保存ESP的位置
+
+// 上下文切换基准测试线程的运行标志
+static volatile bool switch_bench_running = false;
+
 // 内部函数声明
 static pcb_t* allocate_pcb(void);
 static void deallocate_pcb(pcb_t* pcb);
-static void add_to_queue(pcb_t** queue, pcb_t* process);
 static void remove_from_queue(pcb_t** queue, pcb_t* process);
-static pcb_t* find_process_in_queue(pcb_t* queue, uint32_t pid);
+static void add_to_queue(pcb_t** queue, pcb_t* process);
+static uint32_t process_time_slice(pcb_t* process);
+static void reset_sched_levels(void);
+static void age_waiting_processes(void);
+static void reschedule(bool yield);
 static void setup_process_stack(pcb_t* pcb, void* entry_point);
+static bool setup_fork_stack(pcb_t* child, const pcb_t* parent, const trap_frame_t* frame);
+static uint32_t rebase_stack_pointer(uint32_t value, const pcb_t* parent, uint32_t delta);
+static int setup_process_memory(pcb_t* pcb, uint32_t stack_size);
 static void schedule_next_process(void);
+static void process_bootstrap(void);
+static void finish_switch(void);
+static void release_process(pcb_t* process);
+static void switch_bench_thread(void);
 
 // 初始化进程管理器
 int process_manager_init(void) {
@@ -35,6 +53,7 @@ int process_manager_init(void) {
     g_process_manager.time_slice_quantum = DEFAULT_TIME_SLICE;
     g_process_manager.current_tick = 0;
     g_process_manager.scheduler_ticks = 0;
+    scheduler_init();
     
     // 创建空闲进程（PID 0）
     pcb_t* idle_process = allocate_pcb();
@@ -45,9 +64,10 @@ int process_manager_init(void) {
     idle_process->pid = 0;
     strcpy(idle_process->name, "idle");
     idle_process->state = PROCESS_STATE_RUNNING;
-    idle_process->priority = PROCESS_PRIORITY_LOW;
-    idle_process->time_slice = 0;
-    idle_process->remaining_slice = 0;
+    idle_process->priority = PROCESS_PRIORITY_NORMAL;  // 同时也是shell，不能被普通进程饿死
+    idle_process->level = idle_process->priority;
+    idle_process->time_slice = process_time_slice(idle_process);
+    idle_process->remaining_slice = idle_process->time_slice;
     
     g_process_manager.running_process = idle_process;
     g_process_manager.process_count = 1;
@@ -79,16 +99,23 @@ static void deallocate_pcb(pcb_t* pcb) {
     }
 }
 
-// 添加进程到队列
+// 添加进程到队列尾部
 static void add_to_queue(pcb_t** queue, pcb_t* process) {
     if (!queue || !process) return;
     
-    process->next = *queue;
-    if (*queue) {
-        (*queue)->prev = process;
+    process->next = NULL;
+    if (!*queue) {
+        process->prev = NULL;
+        *queue = process;
+        return;
     }
-    process->prev = NULL;
-    *queue = process;
+    
+    pcb_t* tail = *queue;
+    while (tail->next) {
+        tail = tail->next;
+    }
+    tail->next = process;
+    process->prev = tail;
 }
 
 // 从队列中移除进程
@@ -109,19 +136,48 @@ static void remove_from_queue(pcb_t** queue, pcb_t* process) {
     process->prev = NULL;
 }
 
-// 在队列中查找进程
-static pcb_t* find_process_in_queue(pcb_t* queue, uint32_t pid) {
-    pcb_t* current = queue;
-    while (current) {
-        if (current->pid == pid) {
-            return current;
+// 进程在当前调度级别的时间片
+static uint32_t process_time_slice(pcb_t* process) {
+    return scheduler_time_slice(process, g_process_manager.time_slice_quantum);
+}
+
+// 所有进程回到自己的静态优先级：MLFQ的周期性提升，以及切换调度策略时使用
+static void reset_sched_levels(void) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* process = &process_pool[i];
+        if (!process_pool_used[i] || process->level == process->priority) {
+            continue;
+        }
+        if (process->state == PROCESS_STATE_READY) {
+            scheduler_remove_process(process);
+            process->level = process->priority;
+            scheduler_add_process(process);
+        } else {
+            process->level = process->priority;
         }
-        current = current->next;
     }
-    return NULL;
 }
 
-// 设置进程栈
+// PRIORITY策略的老化：超过一个老化周期没有运行的就绪进程临时提到CRITICAL，
+// 跑完（或让出）一个时间片后由scheduler_task_expired/yielded放回原级别。
+// 这样高优先级的忙循环进程也饿不死shell和低优先级进程
+static void age_waiting_processes(void) {
+    uint32_t interval = PRIORITY_AGING_INTERVAL_MS * TIMER_HZ / 1000;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* process = &process_pool[i];
+        if (!process_pool_used[i] || process->state != PROCESS_STATE_READY ||
+            process->level == PROCESS_PRIORITY_CRITICAL) {
+            continue;
+        }
+        if (g_process_manager.current_tick - process->last_run_time >= interval) {
+            scheduler_remove_process(process);
+            process->level = PROCESS_PRIORITY_CRITICAL;
+            scheduler_add_process(process);
+        }
+    }
+}
+
+// 设置进程栈：伪造一个switch_to_asm保存的现场，第一次切换到该进程时从process_bootstrap开始执行
 static void setup_process_stack(pcb_t* pcb, void* entry_point) {
     if (!pcb || !entry_point) return;
     
@@ -133,11 +189,18 @@ static void setup_process_stack(pcb_t* pcb, void* entry_point) {
         return;
     }
     
-    // 设置栈指针（栈向下增长）
-    pcb->esp = pcb->stack_base + pcb->stack_size - 16;
-    pcb->ebp = pcb->esp;
+    // 栈顶向下依次是：process_bootstrap的返回地址（不会用到）、switch_to_asm的返回地址、ebp/ebx/esi/edi
+    uint32_t* stack = (uint32_t*)(pcb->stack_base + pcb->stack_size);
+    *--stack = 0;
+    *--stack = (uint32_t)process_bootstrap;
+    *--stack = 0;  // ebp
+    *--stack = 0;  // ebx
+    *--stack = 0;  // esi
+    *--stack = 0;  // edi
+    pcb->esp = (uint32_t)stack;
+    pcb->ebp = 0;
     
-    // 设置指令指针
+    // 入口函数由process_bootstrap调用
     pcb->eip = (uint32_t)entry_point;
     
     // 设置段寄存器
@@ -150,19 +213,106 @@ static void setup_process_stack(pcb_t* pcb, void* entry_point) {
     
     // 设置标志寄存器
     pcb->eflags = 0x202;  // 中断使能
+}
+
+// 父进程栈内的地址平移到子进程栈的对应位置，其他值原样返回
+static uint32_t rebase_stack_pointer(uint32_t value, const pcb_t* parent, uint32_t delta) {
+    if (value >= parent->stack_base && value < parent->stack_base + parent->stack_size) {
+        return value + delta;
+    }
+    return value;
+}
+
+// 设置fork出的子进程的栈：把父进程栈上的陷阱帧和它上方的调用帧复制到子进程栈的相同偏移处，
+// 下面再伪造switch_to_asm的现场，第一次切换到子进程时ret到fork_return_asm，从陷阱帧iret返回
+static bool setup_fork_stack(pcb_t* child, const pcb_t* parent, const trap_frame_t* frame) {
+    child->stack_size = parent->stack_size;
+    child->stack_base = (uint32_t)kmalloc(child->stack_size);
+    if (!child->stack_base) {
+        return false;
+    }
+    
+    uint32_t delta = child->stack_base - parent->stack_base;
+    uint32_t used = parent->stack_base + parent->stack_size - (uint32_t)frame;
+    trap_frame_t* child_frame = (trap_frame_t*)((uint32_t)frame + delta);
+    memcpy(child_frame, frame, used);
+    child_frame->eax = 0;  // fork在子进程中返回0
+    
+    // 复制来的帧指针链和寄存器仍指向父进程的栈，逐个平移（内核带帧指针编译）；
+    // 调用帧中以其他形式保存的栈地址无法识别，fork的调用者不能把局部变量的地址留在寄存器之外
+    child_frame->ebp = rebase_stack_pointer(child_frame->ebp, parent, delta);
+    child_frame->ebx = rebase_stack_pointer(child_frame->ebx, parent, delta);
+    child_frame->ecx = rebase_stack_pointer(child_frame->ecx, parent, delta);
+    child_frame->edx = rebase_stack_pointer(child_frame->edx, parent, delta);
+    child_frame->esi = rebase_stack_pointer(child_frame->esi, parent, delta);
+    child_frame->edi = rebase_stack_pointer(child_frame->edi, parent, delta);
+    
+    uint32_t child_top = child->stack_base + child->stack_size;
+    uint32_t fp = child_frame->ebp;
+    while (fp >= (uint32_t)child_frame && fp + sizeof(uint32_t) <= child_top) {
+        uint32_t* saved = (uint32_t*)fp;
+        uint32_t next = rebase_stack_pointer(*saved, parent, delta);
+        if (next == *saved) {
+            break;  // 帧指针链走出了父进程的栈（最外层的ebp为0）
+        }
+        *saved = next;
+        fp = next;
+    }
+    
+    // switch_to_asm恢复的现场：ebp/ebx/esi/edi不会被用到，返回地址是fork_return_asm
+    uint32_t* stack = (uint32_t*)child_frame;
+    *--stack = (uint32_t)fork_return_asm;
+    *--stack = 0;  // ebp
+    *--stack = 0;  // ebx
+    *--stack = 0;  // esi
+    *--stack = 0;  // edi
+    child->esp = (uint32_t)stack;
+    child->ebp = child_frame->ebp;
+    return true;
+}
+
+// fork出的子进程第一次被切换到时由fork_return_asm调用，之后从陷阱帧返回，中断标志由iret恢复
+void process_fork_return(void) {
+    finish_switch();
+}
+
+// 新进程第一次被切换到时从这里开始：完成切换的收尾工作，开中断后调用入口函数，返回即退出
+static void process_bootstrap(void) {
+    finish_switch();
+    __asm__ volatile("sti");
+    
+    pcb_t* self = g_process_manager.running_process;
+    ((void (*)(void))self->eip)();
+    
+    process_terminate(self->pid);
+}
+
+// 建立进程地址空间：用户栈只登记区域，页面在首次访问时才分配；堆从空开始，由brk/sbrk增长
+static int setup_process_memory(pcb_t* pcb, uint32_t stack_size) {
+    pcb->mm = create_memory_context();
+    if (!pcb->mm) {
+        return PROCESS_ERROR_NO_MEMORY;
+    }
+    
+    pcb->user_stack_size = align_to_page(stack_size ? stack_size : DEFAULT_USER_STACK_SIZE);
+    pcb->user_stack_base = USER_STACK_TOP - pcb->user_stack_size;
+    pcb->heap_base = pcb->mm->heap_start;
+    pcb->heap_size = 0;
+    
+    if (!map_memory_region(pcb->mm, pcb->user_stack_base, USER_STACK_TOP,
+                           VM_READ | VM_WRITE | VM_STACK)) {
+        destroy_memory_context(pcb->mm);
+        pcb->mm = NULL;
+        return PROCESS_ERROR_NO_MEMORY;
+    }
     
-    // 在栈上设置返回地址（进程退出时调用process_terminate）
-    uint32_t* stack = (uint32_t*)pcb->esp;
-    stack[0] = 0;  // 返回地址（进程退出）
-    stack[1] = (uint32_t)process_terminate;  // 退出函数
-    stack[2] = pcb->pid;  // 参数
+    return PROCESS_SUCCESS;
 }
 
 // 创建进程
 int process_create(const char* name, void* entry_point, process_priority_t priority, uint32_t stack_size) {
-    (void)stack_size;  // 暂时未使用，避免警告
-    
-    if (!name || !entry_point) {
+    if (!name || !entry_point ||
+        priority < PROCESS_PRIORITY_LOW || priority > PROCESS_PRIORITY_CRITICAL) {
         return PROCESS_ERROR_INVALID_PARAM;
     }
     
@@ -182,7 +332,8 @@ int process_create(const char* name, void* entry_point, process_priority_t prior
     new_process->name[PROCESS_NAME_MAX] = '\0';
     new_process->state = PROCESS_STATE_NEW;
     new_process->priority = priority;
-    new_process->time_slice = g_process_manager.time_slice_quantum;
+    new_process->level = priority;
+    new_process->time_slice = process_time_slice(new_process);
     new_process->remaining_slice = new_process->time_slice;
     new_process->creation_time = g_process_manager.current_tick;
     new_process->last_run_time = 0;
@@ -190,18 +341,97 @@ int process_create(const char* name, void* entry_point, process_priority_t prior
     new_process->exit_code = 0;
     new_process->file_count = 0;
     
+    // 建立地址空间
+    if (setup_process_memory(new_process, stack_size) != PROCESS_SUCCESS) {
+        deallocate_pcb(new_process);
+        return PROCESS_ERROR_NO_MEMORY;
+    }
+    
     // 设置进程栈
     setup_process_stack(new_process, entry_point);
+    if (!new_process->stack_base) {
+        destroy_memory_context(new_process->mm);
+        deallocate_pcb(new_process);
+        return PROCESS_ERROR_NO_MEMORY;
+    }
     
     // 添加到就绪队列
     new_process->state = PROCESS_STATE_READY;
-    add_to_queue(&g_process_manager.ready_queue, new_process);
-    
+    uint32_t flags = irq_save();
+    scheduler_add_process(new_process);
     g_process_manager.process_count++;
+    irq_restore(flags);
     
     return new_process->pid;
 }
 
+// 复制当前进程：地址空间写时复制共享；子进程的内核栈由当前的int 0x80陷阱帧构造，
+// 和父进程一样从这次系统调用返回，只是返回值为0
+int process_fork(void) {
+    pcb_t* parent = g_process_manager.running_process;
+    if (!parent) {
+        return PROCESS_ERROR_NOT_FOUND;
+    }
+    
+    if (g_process_manager.process_count >= g_process_manager.max_processes) {
+        return PROCESS_ERROR_QUEUE_FULL;
+    }
+    
+    // 只有经int 0x80进入的调用才有可以返回的陷阱帧；空闲进程运行在启动栈上，无法复制
+    trap_frame_t* frame = parent->trap_frame;
+    if (!parent->stack_base || !frame) {
+        return PROCESS_ERROR_INVALID_STATE;
+    }
+    
+    pcb_t* child = allocate_pcb();
+    if (!child) {
+        return PROCESS_ERROR_NO_MEMORY;
+    }
+    
+    // 优先级和各个区域的位置都与父进程相同
+    *child = *parent;
+    child->next = NULL;
+    child->prev = NULL;
+    child->children = NULL;
+    child->mm = NULL;
+    child->stack_base = 0;
+    child->trap_frame = NULL;
+    
+    if (parent->mm) {
+        child->mm = clone_memory_context(parent->mm);
+        if (!child->mm) {
+            deallocate_pcb(child);
+            return PROCESS_ERROR_NO_MEMORY;
+        }
+    }
+    
+    if (!setup_fork_stack(child, parent, frame)) {
+        destroy_memory_context(child->mm);
+        deallocate_pcb(child);
+        return PROCESS_ERROR_NO_MEMORY;
+    }
+    
+    child->pid = g_process_manager.next_pid++;
+    child->state = PROCESS_STATE_READY;
+    child->level = child->priority;
+    child->time_slice = process_time_slice(child);
+    child->remaining_slice = child->time_slice;
+    child->creation_time = g_process_manager.current_tick;
+    child->last_run_time = 0;
+    child->cpu_time = 0;
+    
+    child->parent = parent;
+    child->sibling = parent->children;
+    parent->children = child;
+    
+    uint32_t flags = irq_save();
+    scheduler_add_process(child);
+    g_process_manager.process_count++;
+    irq_restore(flags);
+    
+    return child->pid;
+}
+
 // 终止进程
 int process_terminate(uint32_t pid) {
     pcb_t* process = process_get_by_pid(pid);
@@ -209,73 +439,122 @@ int process_terminate(uint32_t pid) {
         return PROCESS_ERROR_NOT_FOUND;
     }
     
-    // 从当前队列中移除
-    if (process == g_process_manager.running_process) {
-        g_process_manager.running_process = NULL;
-    } else {
-        remove_from_queue(&g_process_manager.ready_queue, process);
-        remove_from_queue(&g_process_manager.blocked_queue, process);
+    // 空闲进程运行在启动栈上，不能终止
+    if (process->pid == 0) {
+        return PROCESS_ERROR_INVALID_PID;
     }
     
-    // 添加到终止队列
+    // 关中断直到完成：终止自己时切换走之后不会再回来
+    uint32_t flags = irq_save();
+    bool self = (process == g_process_manager.running_process);
+    if (process->state == PROCESS_STATE_READY) {
+        scheduler_remove_process(process);
+    } else if (process->state == PROCESS_STATE_BLOCKED) {
+        remove_from_queue(&g_process_manager.blocked_queue, process);
+    }
     process->state = PROCESS_STATE_TERMINATED;
-    add_to_queue(&g_process_manager.terminated_queue, process);
     
-    // 释放资源
-    if (process->stack_base) {
-        kfree((void*)process->stack_base);
-    }
-    if (process->heap_base) {
-        kfree((void*)process->heap_base);
+    if (process->mm) {
+        destroy_memory_context(process->mm);
+        process->mm = NULL;
     }
     
-    // 释放进程控制块
-    deallocate_pcb(process);
+    // 从父进程的子进程链表中摘除，子进程成为孤儿
+    if (process->parent) {
+        pcb_t** link = &process->parent->children;
+        while (*link && *link != process) {
+            link = &(*link)->sibling;
+        }
+        if (*link) {
+            *link = process->sibling;
+        }
+    }
+    for (pcb_t* child = process->children; child; child = child->sibling) {
+        child->parent = NULL;
+    }
     
     g_process_manager.process_count--;
     
-    // 如果当前进程被终止，调度下一个进程
-    if (process == g_process_manager.running_process) {
+    // 终止的是当前进程：仍在使用它的内核栈，交给下一个运行的进程释放，这里不会返回
+    if (self) {
+        zombie_process = process;
         schedule_next_process();
     }
     
+    release_process(process);
+    irq_restore(flags);
     return PROCESS_SUCCESS;
 }
 
+// 释放进程的内核栈和进程控制块
+static void release_process(pcb_t* process) {
+    if (process->stack_base) {
+        kfree((void*)process->stack_base);
+        process->stack_base = 0;
+    }
+    deallocate_pcb(process);
+}
+
 // 杀死进程
 int process_kill(uint32_t pid) {
     return process_terminate(pid);
 }
 
-// 进程调度器
+// 进程调度器：时间片用完或有更高优先级的进程就绪时切换（调用时必须关中断）
 void process_scheduler(void) {
     g_process_manager.scheduler_ticks++;
     
-    // 如果当前进程时间片用完，需要切换
-    if (g_process_manager.running_process && 
-        g_process_manager.running_process->remaining_slice <= 0) {
-        
-        // 保存当前进程上下文
-        if (g_process_manager.running_process->state == PROCESS_STATE_RUNNING) {
-            g_process_manager.running_process->state = PROCESS_STATE_READY;
-            add_to_queue(&g_process_manager.ready_queue, g_process_manager.running_process);
-        }
-        
-        // 调度下一个进程
-        schedule_next_process();
+    pcb_t* current = g_process_manager.running_process;
+    if (!current) {
+        return;
+    }
+    
+    if (current->remaining_slice == 0 || scheduler_should_preempt(current)) {
+        reschedule(false);
     }
 }
 
-// 调度下一个进程
-static void schedule_next_process(void) {
-    pcb_t* next_process = NULL;
+// 选出下一个进程并切换过去
+// 时间片用完时当前进程先回到自己队列的尾部，只有同级或更高级别的进程能接替它；
+// 主动让出（yield）时先选再放回，任何就绪进程都能得到CPU
+static void reschedule(bool yield) {
+    pcb_t* current = g_process_manager.running_process;
+    bool runnable = (current->state == PROCESS_STATE_RUNNING);
+    
+    // 记上最后一段运行时间，公平策略按新的vruntime重新入队
+    scheduler_account(current, g_process_manager.current_tick);
+    
+    // MLFQ反馈：用完时间片的降级，提前让出的升级（阻塞的在process_block中处理）
+    if (runnable && current->remaining_slice == 0) {
+        scheduler_task_expired(current);
+    } else if (runnable && yield) {
+        scheduler_task_yielded(current);
+    }
     
-    // 从就绪队列中选择下一个进程（简单轮转调度）
-    if (g_process_manager.ready_queue) {
-        next_process = g_process_manager.ready_queue;
-        remove_from_queue(&g_process_manager.ready_queue, next_process);
+    if (runnable && !yield) {
+        current->state = PROCESS_STATE_READY;
+        scheduler_add_process(current);
     }
     
+    pcb_t* next = scheduler_pick_next();
+    if (!next) {
+        // 没有其他就绪进程时继续运行当前进程
+        current->time_slice = process_time_slice(current);
+        current->remaining_slice = current->time_slice;
+        return;
+    }
+    
+    if (runnable && yield) {
+        current->state = PROCESS_STATE_READY;
+        scheduler_add_process(current);
+    }
+    process_switch(next);
+}
+
+// 调度下一个进程
+static void schedule_next_process(void) {
+    pcb_t* next_process = scheduler_pick_next();
+    
     // 如果没有就绪进程，使用空闲进程
     if (!next_process) {
         next_process = process_get_by_pid(0);  // 空闲进程
@@ -286,33 +565,194 @@ static void schedule_next_process(void) {
     }
 }
 
-// 进程切换
+// 进程切换：切换地址空间和内核栈，返回时已经重新轮到旧进程运行
+// 调用者必须关中断，恢复运行的进程在自己的irq_restore或iret中恢复中断状态
 void process_switch(pcb_t* new_process) {
     if (!new_process) return;
     
     pcb_t* old_process = g_process_manager.running_process;
     
-    // 保存旧进程上下文
-    if (old_process && old_process->state == PROCESS_STATE_RUNNING) {
-        process_save_context(old_process);
-    }
-    
     // 切换到新进程
     g_process_manager.running_process = new_process;
+    switch_memory_context(new_process->mm);
     new_process->state = PROCESS_STATE_RUNNING;
+    new_process->time_slice = process_time_slice(new_process);
     new_process->remaining_slice = new_process->time_slice;
     new_process->last_run_time = g_process_manager.current_tick;
     
-    // 恢复新进程上下文
-    process_restore_context(new_process);
+    if (old_process == new_process) {
+        return;
+    }
+    
+    // 已终止进程的现场不会再恢复，ESP存到一个丢弃的位置
+    g_process_manager.context_switches++;
+    switch_to_asm(old_process && old_process != zombie_process ? &old_process->esp : &zombie_esp,
+                  new_process->esp);
+    finish_switch();
+}
+
+// 切换完成后在新进程的栈上执行：释放刚切换离开的已终止进程
+static void finish_switch(void) {
+    if (zombie_process && zombie_process != g_process_manager.running_process) {
+        release_process(zombie_process);
+        zombie_process = NULL;
+    }
 }
 
 // 让出CPU
 void process_yield(void) {
+    uint32_t flags = irq_save();
     if (g_process_manager.running_process) {
-        g_process_manager.running_process->remaining_slice = 0;
-        process_scheduler();
+        g_process_manager.scheduler_ticks++;
+        reschedule(true);
+    }
+    irq_restore(flags);
+}
+
+// 时钟中断中调用（已关中断）：时间记账，时间片用完时抢占当前进程
+void scheduler_tick(void) {
+    g_process_manager.current_tick++;
+    
+    pcb_t* current = g_process_manager.running_process;
+    if (!current) {
+        return;
+    }
+    
+    current->cpu_time++;
+    scheduler_account(current, g_process_manager.current_tick);
+    if (current->remaining_slice > 0) {
+        current->remaining_slice--;
+    }
+    
+    // MLFQ周期性地把所有进程提升回原来的优先级，降级的批处理任务不会被饿死
+    if (scheduler_get_policy() == SCHED_POLICY_MLFQ &&
+        g_process_manager.current_tick % (MLFQ_BOOST_INTERVAL_MS * TIMER_HZ / 1000) == 0) {
+        reset_sched_levels();
+    }
+    
+    // PRIORITY策略没有降级，靠老化保证长时间等待的进程（包括shell）能拿到CPU
+    if (scheduler_get_policy() == SCHED_POLICY_PRIORITY &&
+        g_process_manager.current_tick % (PRIORITY_AGING_INTERVAL_MS * TIMER_HZ / 1000) == 0) {
+        age_waiting_processes();
+    }
+    
+    process_scheduler();
+}
+
+// 切换调度策略：就绪进程先移出队列，级别重置为静态优先级后按新策略重新入队
+int process_set_policy(sched_policy_t policy) {
+    if (policy >= SCHED_POLICY_COUNT) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t flags = irq_save();
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (process_pool_used[i] && process_pool[i].state == PROCESS_STATE_READY) {
+            scheduler_remove_process(&process_pool[i]);
+        }
+    }
+    
+    scheduler_set_policy(policy);
+    
+    // 所有进程从同一起点开始
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* process = &process_pool[i];
+        if (!process_pool_used[i]) {
+            continue;
+        }
+        process->level = process->priority;
+        process->vruntime = 0;
+        process->last_run_time = g_process_manager.current_tick;
+        if (process->state == PROCESS_STATE_READY) {
+            scheduler_add_process(process);
+        }
+    }
+    
+    pcb_t* current = g_process_manager.running_process;
+    if (current) {
+        current->time_slice = process_time_slice(current);
+        if (current->remaining_slice > current->time_slice) {
+            current->remaining_slice = current->time_slice;
+        }
+    }
+    irq_restore(flags);
+    return PROCESS_SUCCESS;
+}
+
+// 阻塞进程：阻塞自己时切换到下一个进程，直到process_unblock后才返回
+int process_block(uint32_t pid) {
+    pcb_t* process = process_get_by_pid(pid);
+    if (!process) {
+        return PROCESS_ERROR_NOT_FOUND;
+    }
+    
+    // 空闲进程必须始终可运行
+    if (process->pid == 0) {
+        return PROCESS_ERROR_INVALID_PID;
+    }
+    
+    uint32_t flags = irq_save();
+    if (process->state == PROCESS_STATE_BLOCKED) {
+        irq_restore(flags);
+        return PROCESS_ERROR_INVALID_STATE;
+    }
+    
+    bool self = (process == g_process_manager.running_process);
+    if (process->state == PROCESS_STATE_READY) {
+        scheduler_remove_process(process);
+    }
+    
+    // 时间片用完之前就阻塞，按交互式进程对待
+    if (self && process->remaining_slice > 0) {
+        scheduler_task_yielded(process);
     }
+    process->state = PROCESS_STATE_BLOCKED;
+    add_to_queue(&g_process_manager.blocked_queue, process);
+    
+    if (self) {
+        reschedule(true);
+    }
+    irq_restore(flags);
+    return PROCESS_SUCCESS;
+}
+
+// 唤醒阻塞的进程，放回它所在级别的就绪队列
+int process_unblock(uint32_t pid) {
+    pcb_t* process = process_get_by_pid(pid);
+    if (!process) {
+        return PROCESS_ERROR_NOT_FOUND;
+    }
+    
+    uint32_t flags = irq_save();
+    if (process->state != PROCESS_STATE_BLOCKED) {
+        irq_restore(flags);
+        return PROCESS_ERROR_INVALID_STATE;
+    }
+    
+    remove_from_queue(&g_process_manager.blocked_queue, process);
+    process->state = PROCESS_STATE_READY;
+    scheduler_add_process(process);
+    irq_restore(flags);
+    return PROCESS_SUCCESS;
+}
+
+// 空闲进程的后台工作：有就绪进程时让出CPU，否则预先清零一批页面
+// 返回true表示做了工作，调用者应再次检查输入而不是立即hlt
+bool process_idle(void) {
+    pcb_t* current = g_process_manager.running_process;
+    if (current && current->pid != 0) {
+        return false;
+    }
+    if (scheduler_has_ready()) {
+        process_yield();
+        return true;
+    }
+    
+    // 先把空闲页补回水位之上，再预清零页面
+    if (balance_memory()) {
+        return true;
+    }
+    return refill_zeroed_pages(IDLE_ZERO_BATCH) != 0;
 }
 
 // 根据PID获取进程
@@ -322,17 +762,13 @@ pcb_t* process_get_by_pid(uint32_t pid) {
         return g_process_manager.running_process;
     }
     
-    // 检查就绪队列
-    pcb_t* process = find_process_in_queue(g_process_manager.ready_queue, pid);
-    if (process) return process;
-    
-    // 检查阻塞队列
-    process = find_process_in_queue(g_process_manager.blocked_queue, pid);
-    if (process) return process;
-    
-    // 检查终止队列
-    process = find_process_in_queue(g_process_manager.terminated_queue, pid);
-    if (process) return process;
+    // 就绪进程分散在调度器的各个队列中，直接查进程池
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (process_pool_used[i] && process_pool[i].pid == pid &&
+            process_pool[i].state != PROCESS_STATE_TERMINATED) {
+            return &process_pool[i];
+        }
+    }
     
     return NULL;
 }
@@ -342,22 +778,47 @@ pcb_t* process_get_current(void) {
     return g_process_manager.running_process;
 }
 
-// 保存进程上下文
-void process_save_context(pcb_t* pcb) {
-    if (!pcb) return;
-    
-    // 这里应该保存当前CPU寄存器到PCB
-    // 由于我们在C代码中，实际的寄存器保存需要在汇编中完成
-    // 这里只是标记需要保存上下文
+// 基准测试线程：不断让出CPU，直到测试结束
+static void switch_bench_thread(void) {
+    while (switch_bench_running) {
+        process_yield();
+    }
 }
 
-// 恢复进程上下文
-void process_restore_context(pcb_t* pcb) {
-    if (!pcb) return;
+// 上下文切换基准：与一个只会让出CPU的内核线程来回切换rounds次，返回切换次数和消耗的TSC周期
+// 只能由空闲进程调用，测试期间其他就绪进程也会参与轮转
+int process_switch_benchmark(uint32_t rounds, uint32_t* switches, uint32_t* cycles) {
+    if (!switches || !cycles || !rounds) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+    if (g_process_manager.running_process->pid != 0) {
+        return PROCESS_ERROR_INVALID_STATE;
+    }
+    
+    switch_bench_running = true;
+    int pid = process_create("ctxbench", (void*)switch_bench_thread, PROCESS_PRIORITY_NORMAL, 0);
+    if (pid < 0) {
+        switch_bench_running = false;
+        return pid;
+    }
+    
+    // 第一次切换会进入新线程的process_bootstrap，不计入测量
+    process_yield();
+    
+    uint32_t start_switches = g_process_manager.context_switches;
+    uint32_t start = read_tsc();
+    for (uint32_t i = 0; i < rounds; i++) {
+        process_yield();
+    }
+    *cycles = read_tsc() - start;
+    *switches = g_process_manager.context_switches - start_switches;
     
-    // 这里应该从PCB恢复CPU寄存器
-    // 由于我们在C代码中，实际的寄存器恢复需要在汇编中完成
-    // 这里只是标记需要恢复上下文
+    // 让测试线程看到结束标志后自行退出
+    switch_bench_running = false;
+    while (process_get_by_pid((uint32_t)pid)) {
+        process_yield();
+    }
+    return PROCESS_SUCCESS;
 }
 
 // 获取进程信息
@@ -378,7 +839,26 @@ int process_set_priority(uint32_t pid, process_priority_t priority) {
         return PROCESS_ERROR_NOT_FOUND;
     }
     
-    process->priority = priority;
+    if (priority < PROCESS_PRIORITY_LOW || priority > PROCESS_PRIORITY_CRITICAL) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+    
+    // 就绪进程要换到新级别的队列中
+    uint32_t flags = irq_save();
+    if (process->state == PROCESS_STATE_READY) {
+        scheduler_remove_process(process);
+        process->priority = priority;
+        process->level = priority;
+        scheduler_add_process(process);
+    } else {
+        process->priority = priority;
+        process->level = priority;
+    }
+    process->time_slice = process_time_slice(process);
+    if (process->remaining_slice > process->time_slice) {
+        process->remaining_slice = process->time_slice;
+    }
+    irq_restore(flags);
     return PROCESS_SUCCESS;
 }
 
@@ -440,26 +920,12 @@ int process_get_list(pcb_t* processes, uint32_t max_count, uint32_t* count) {
     
     *count = 0;
     
-    // 添加当前运行进程
-    if (g_process_manager.running_process && *count < max_count) {
-        processes[*count] = *g_process_manager.running_process;
-        (*count)++;
-    }
-    
-    // 添加就绪队列中的进程
-    pcb_t* current = g_process_manager.ready_queue;
-    while (current && *count < max_count) {
-        processes[*count] = *current;
-        (*count)++;
-        current = current->next;
-    }
-    
-    // 添加阻塞队列中的进程
-    current = g_process_manager.blocked_queue;
-    while (current && *count < max_count) {
-        processes[*count] = *current;
-        (*count)++;
-        current = current->next;
+    // 运行、就绪和阻塞的进程都在进程池中
+    for (int i = 0; i < MAX_PROCESSES && *count < max_count; i++) {
+        if (process_pool_used[i] && process_pool[i].state != PROCESS_STATE_TERMINATED) {
+            processes[*count] = process_pool[i];
+            (*count)++;
+        }
     }
     
     return PROCESS_SUCCESS;
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../memory.h"
+#include "../../lib/rbtree.h"
 
 // Process state definitions
 typedef enum {
@@ -21,12 +23,34 @@ typedef enum {
     PROCESS_PRIORITY_CRITICAL = 4
 } process_priority_t;
 
+#define PROCESS_PRIORITY_LEVELS 4
+
+// Scheduling policy
+typedef enum {
+    SCHED_POLICY_PRIORITY,    // Strict priority, round robin within a level
+    SCHED_POLICY_MLFQ,        // Multilevel feedback queue below each task's priority
+    SCHED_POLICY_FAIR,        // Weighted fair share: smallest vruntime runs next
+    SCHED_POLICY_COUNT
+} sched_policy_t;
+
+#ifndef SCHED_DEFAULT_POLICY
+#define SCHED_DEFAULT_POLICY SCHED_POLICY_PRIORITY   // make SCHED=mlfq|fair changes the boot-time policy
+#endif
+
+// int 0x80 trap frame: registers pushed by syscall_entry, then the return state
+// pushed by the CPU (same privilege level, so no SS/ESP)
+typedef struct {
+    uint32_t ebp, edi, esi, edx, ecx, ebx, eax;
+    uint32_t eip, cs, eflags;
+} trap_frame_t;
+
 // Process Control Block (PCB)
 typedef struct process_control_block {
     uint32_t pid;                    // Process ID
     char name[32];                   // Process name
     process_state_t state;           // Process state
     process_priority_t priority;     // Process priority
+    process_priority_t level;        // Current run queue level (MLFQ moves it between LOW and priority)
     
     // Register context
     uint32_t eax, ebx, ecx, edx;     // General purpose registers
@@ -35,12 +59,16 @@ typedef struct process_control_block {
     uint32_t eip;                    // Instruction pointer
     uint32_t eflags;                 // Flags register
     uint32_t cs, ds, es, fs, gs, ss; // Segment registers
+    trap_frame_t* trap_frame;        // Innermost int 0x80 frame on the kernel stack (NULL outside syscalls)
     
     // Memory management
-    uint32_t stack_base;             // Stack base address
-    uint32_t stack_size;             // Stack size
-    uint32_t heap_base;              // Heap base address
-    uint32_t heap_size;              // Heap size
+    memory_context_t* mm;            // Address space (NULL for kernel-only processes)
+    uint32_t stack_base;             // Kernel stack base address
+    uint32_t stack_size;             // Kernel stack size
+    uint32_t user_stack_base;        // User stack region (demand paged)
+    uint32_t user_stack_size;        // User stack size
+    uint32_t heap_base;              // User heap region (demand paged)
+    uint32_t heap_size;              // Current break minus heap_base (moved by brk/sbrk)
     
     // Time management
     uint32_t cpu_time;               // CPU time
@@ -50,6 +78,8 @@ typedef struct process_control_block {
     // Scheduling information
     uint32_t time_slice;             // Time slice
     uint32_t remaining_slice;        // Remaining time slice
+    uint32_t vruntime;               // Priority-weighted CPU time (fair policy)
+    rb_node_t run_node;              // Fair policy run queue node
     
     // Linked list pointers
     struct process_control_block* next;
@@ -68,12 +98,16 @@ typedef struct process_control_block {
     uint32_t file_count;             // Number of open files
 } pcb_t;
 
-// Process manager state
+// FIFO run queue for one priority level
+typedef struct {
+    pcb_t* head;
+    pcb_t* tail;
+} run_queue_t;
+
+// Process manager state (ready processes live in the scheduler's run queues)
 typedef struct {
     pcb_t* running_process;          // Currently running process
-    pcb_t* ready_queue;              // Ready queue
     pcb_t* blocked_queue;            // Blocked queue
-    pcb_t* terminated_queue;         // Terminated queue
     
     uint32_t next_pid;               // Next process ID
     uint32_t process_count;          // Total process count
@@ -83,6 +117,7 @@ typedef struct {
     uint32_t time_slice_quantum;     // Time slice size
     uint32_t current_tick;           // Current clock tick
     uint32_t scheduler_ticks;        // Scheduler clock ticks
+    uint32_t context_switches;       // Stack switches performed by process_switch()
 } process_manager_t;
 
 // 进程管理函数声明
@@ -94,11 +129,14 @@ int process_manager_init(void);
 int process_create(const char* name, void* entry_point, process_priority_t priority, uint32_t stack_size);
 int process_terminate(uint32_t pid);
 int process_kill(uint32_t pid);
+int process_fork(void);
+void process_fork_return(void);
 
 // 进程调度
 void process_scheduler(void);
 void process_switch(pcb_t* new_process);
 void process_yield(void);
+bool process_idle(void);
 
 // 进程状态管理
 int process_block(uint32_t pid);
@@ -121,14 +159,24 @@ int process_send_signal(uint32_t pid, uint32_t signal);
 int process_wait(uint32_t pid, int32_t* exit_code);
 
 // 上下文切换
-void process_save_context(pcb_t* pcb);
-void process_restore_context(pcb_t* pcb);
+int process_switch_benchmark(uint32_t rounds, uint32_t* switches, uint32_t* cycles);
 
 // 调度器
 void scheduler_init(void);
 void scheduler_tick(void);
 void scheduler_add_process(pcb_t* process);
 void scheduler_remove_process(pcb_t* process);
+pcb_t* scheduler_pick_next(void);
+bool scheduler_has_ready(void);
+bool scheduler_should_preempt(pcb_t* current);
+sched_policy_t scheduler_get_policy(void);
+void scheduler_set_policy(sched_policy_t policy);
+const char* scheduler_policy_name(sched_policy_t policy);
+uint32_t scheduler_time_slice(const pcb_t* process, uint32_t quantum);
+void scheduler_account(pcb_t* process, uint32_t now);
+void scheduler_task_expired(pcb_t* process);
+void scheduler_task_yielded(pcb_t* process);
+int process_set_policy(sched_policy_t policy);
 
 // 进程管理工具函数
 const char* process_state_to_string(process_state_t state);
@@ -138,7 +186,14 @@ void process_print_info(pcb_t* pcb);
 // 常量定义
 #define MAX_PROCESSES 64
 #define DEFAULT_STACK_SIZE 4096
-#define DEFAULT_TIME_SLICE 10
+#define SWITCH_BENCH_ROUNDS 10000         // Yield round trips made by the ctxbench command
+#define SCHED_BENCH_WORKERS 3             // schedbench runs one spinner each at LOW, NORMAL and HIGH
+#define SCHED_BENCH_SECONDS 3
+#define DEFAULT_USER_STACK_SIZE 0x10000   // 64KB, pages allocated on first touch
+#define DEFAULT_TIME_SLICE 10             // Ticks for a NORMAL priority task, scaled by priority
+#define MLFQ_BOOST_INTERVAL_MS 1000       // MLFQ resets every task to its priority this often
+#define PRIORITY_AGING_INTERVAL_MS 250    // Priority policy lifts tasks that waited this long to CRITICAL for one slice
+#define IDLE_ZERO_BATCH 4                 // Pages the idle process pre-zeroes per idle pass
 #define PROCESS_NAME_MAX 31
 
 // 错误代码
@@ -151,4 +206,8 @@ void process_print_info(pcb_t* pcb);
 #define PROCESS_ERROR_INVALID_PARAM -6
 #define PROCESS_ERROR_QUEUE_FULL -7
 
+// 汇编函数声明
+extern void switch_to_asm(uint32_t* old_esp, uint32_t new_esp);
+extern void fork_return_asm(void);
+
 #endif // PROCESS_H
@@ -0,0 +1,276 @@
+#include "process.h"
+#include "../../lib/string.h"
+#include "../../lib/rbtree.h"
+#include <stddef.h>
+
+// 公平调度参数：vruntime以NORMAL进程运行一个时钟滴答为FAIR_VRUNTIME_TICK个单位
+#define FAIR_VRUNTIME_TICK 1024
+#define FAIR_PERIOD_SLICES 2                                         // 调度周期为基本时间片的两倍，按权重分给所有可运行进程
+#define FAIR_WAKEUP_GRANULARITY (2 * FAIR_VRUNTIME_TICK)             // 领先最左进程超过该值才抢占，避免来回切换
+#define FAIR_SLEEPER_CREDIT (DEFAULT_TIME_SLICE * FAIR_VRUNTIME_TICK) // 入队进程最多落后min_vruntime这么多
+
+// 每个调度级别一个FIFO就绪队列；ready_bitmap的第(level - 1)位表示对应队列非空
+// 进程按pcb->level入队：PRIORITY策略下level等于priority，只有老化提升时暂时为CRITICAL；MLFQ策略下在LOW和priority之间浮动
+static run_queue_t ready_queues[PROCESS_PRIORITY_LEVELS];
+static uint32_t ready_bitmap = 0;
+static sched_policy_t current_policy = SCHED_DEFAULT_POLICY;
+
+// 公平策略：就绪进程按vruntime排在红黑树中，缓存最左节点；fair_load是树中进程的权重之和
+static rb_root_t fair_tree = {NULL};
+static rb_node_t* fair_leftmost = NULL;
+static uint32_t fair_load = 0;
+static uint32_t min_vruntime = 0;
+
+// 各优先级的权重（NORMAL为1024，相邻级别约差3倍）和每个时钟滴答增加的vruntime
+static const uint32_t fair_weights[PROCESS_PRIORITY_LEVELS] = {335, 1024, 3121, 9548};
+static const uint32_t fair_vruntime_per_tick[PROCESS_PRIORITY_LEVELS] = {3130, 1024, 336, 110};
+
+// 内部函数声明
+static uint32_t priority_level(process_priority_t priority);
+static uint32_t highest_ready_level(void);
+static void queue_add(pcb_t* process);
+static void queue_remove(pcb_t* process);
+static bool vruntime_before(uint32_t a, uint32_t b);
+static void fair_add(pcb_t* process);
+static void fair_remove(pcb_t* process);
+static void update_min_vruntime(pcb_t* current);
+
+// 初始化就绪队列
+void scheduler_init(void) {
+    memset(ready_queues, 0, sizeof(ready_queues));
+    ready_bitmap = 0;
+    fair_tree.node = NULL;
+    fair_leftmost = NULL;
+    fair_load = 0;
+    min_vruntime = 0;
+}
+
+// 当前调度策略
+sched_policy_t scheduler_get_policy(void) {
+    return current_policy;
+}
+
+// 切换调度策略：调用者要先把就绪进程移出队列，重置级别和vruntime后再放回
+void scheduler_set_policy(sched_policy_t policy) {
+    current_policy = policy;
+    min_vruntime = 0;
+}
+
+// 策略名称
+const char* scheduler_policy_name(sched_policy_t policy) {
+    switch (policy) {
+        case SCHED_POLICY_PRIORITY: return "priority";
+        case SCHED_POLICY_MLFQ: return "mlfq";
+        case SCHED_POLICY_FAIR: return "fair";
+        default: return "unknown";
+    }
+}
+
+// 进程在当前级别的时间片（时钟滴答数）
+// PRIORITY：优先级越高时间片越长，LOW为quantum的一半，CRITICAL为两倍（老化提升不改变时间片）
+// MLFQ：反过来，高级别是短时间片的交互队列，降到LOW的批处理任务一次运行两倍quantum
+// FAIR：调度周期按权重在process和其余就绪进程之间分配，至少一个滴答
+uint32_t scheduler_time_slice(const pcb_t* process, uint32_t quantum) {
+    if (current_policy == SCHED_POLICY_FAIR) {
+        uint32_t weight = fair_weights[priority_level(process->priority)];
+        uint32_t slice = quantum * FAIR_PERIOD_SLICES * weight / (fair_load + weight);
+        return slice ? slice : 1;
+    }
+
+    uint32_t scale = process->priority;
+    if (current_policy == SCHED_POLICY_MLFQ) {
+        scale = PROCESS_PRIORITY_LEVELS + 1 - process->level;
+    }
+    return quantum * scale / PROCESS_PRIORITY_NORMAL;
+}
+
+// 按上次记账以来经过的滴答给进程记账：公平策略下vruntime按权重的倒数增长
+void scheduler_account(pcb_t* process, uint32_t now) {
+    uint32_t delta = now - process->last_run_time;
+    process->last_run_time = now;
+
+    if (current_policy == SCHED_POLICY_FAIR && delta) {
+        process->vruntime += delta * fair_vruntime_per_tick[priority_level(process->priority)];
+        update_min_vruntime(process);
+    }
+}
+
+// 进程用完了整个时间片：MLFQ下降一级，PRIORITY下老化提升的进程回到静态优先级
+void scheduler_task_expired(pcb_t* process) {
+    if (current_policy == SCHED_POLICY_PRIORITY) {
+        process->level = process->priority;
+    } else if (current_policy == SCHED_POLICY_MLFQ && process->level > PROCESS_PRIORITY_LOW) {
+        process->level--;
+    }
+}
+
+// 进程在时间片用完前主动让出或阻塞：MLFQ下升一级，最高到自己的静态优先级；PRIORITY下结束老化提升
+void scheduler_task_yielded(pcb_t* process) {
+    if (current_policy == SCHED_POLICY_PRIORITY) {
+        process->level = process->priority;
+    } else if (current_policy == SCHED_POLICY_MLFQ && process->level < process->priority) {
+        process->level++;
+    }
+}
+
+// 优先级对应的队列下标
+static uint32_t priority_level(process_priority_t priority) {
+    return (uint32_t)(priority - PROCESS_PRIORITY_LOW);
+}
+
+// 最高的非空队列：一条bsr指令，调用前ready_bitmap不能为0
+static uint32_t highest_ready_level(void) {
+    uint32_t level;
+    __asm__ volatile("bsrl %1, %0" : "=r"(level) : "rm"(ready_bitmap));
+    return level;
+}
+
+// 把就绪进程加到它所在级别队列的尾部
+static void queue_add(pcb_t* process) {
+    run_queue_t* queue = &ready_queues[priority_level(process->level)];
+    process->next = NULL;
+    process->prev = queue->tail;
+    if (queue->tail) {
+        queue->tail->next = process;
+    } else {
+        queue->head = process;
+    }
+    queue->tail = process;
+
+    ready_bitmap |= 1U << priority_level(process->level);
+}
+
+// 从级别队列中移除进程，队列变空时清除对应位
+static void queue_remove(pcb_t* process) {
+    run_queue_t* queue = &ready_queues[priority_level(process->level)];
+    if (process->prev) {
+        process->prev->next = process->next;
+    } else {
+        queue->head = process->next;
+    }
+    if (process->next) {
+        process->next->prev = process->prev;
+    } else {
+        queue->tail = process->prev;
+    }
+    process->next = NULL;
+    process->prev = NULL;
+
+    if (!queue->head) {
+        ready_bitmap &= ~(1U << priority_level(process->level));
+    }
+}
+
+// vruntime会回绕，按差值的符号比较
+static bool vruntime_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+// 按vruntime插入红黑树，vruntime相同的排在后面；长时间没运行的进程最多领先FAIR_SLEEPER_CREDIT
+static void fair_add(pcb_t* process) {
+    uint32_t floor = min_vruntime - FAIR_SLEEPER_CREDIT;
+    if (vruntime_before(process->vruntime, floor)) {
+        process->vruntime = floor;
+    }
+
+    rb_node_t** link = &fair_tree.node;
+    rb_node_t* parent = NULL;
+    bool leftmost = true;
+    while (*link) {
+        parent = *link;
+        if (vruntime_before(process->vruntime, rb_entry(parent, pcb_t, run_node)->vruntime)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    rb_link_node(&process->run_node, parent, link);
+    rb_insert_color(&process->run_node, &fair_tree);
+    if (leftmost) {
+        fair_leftmost = &process->run_node;
+    }
+    fair_load += fair_weights[priority_level(process->priority)];
+}
+
+// 从红黑树中移除进程
+static void fair_remove(pcb_t* process) {
+    if (fair_leftmost == &process->run_node) {
+        fair_leftmost = rb_next(fair_leftmost);
+    }
+    rb_erase(&process->run_node, &fair_tree);
+    fair_load -= fair_weights[priority_level(process->priority)];
+}
+
+// min_vruntime只增不减，跟随当前进程和最左进程中较小的vruntime
+static void update_min_vruntime(pcb_t* current) {
+    uint32_t vruntime = current->vruntime;
+    if (fair_leftmost) {
+        uint32_t leftmost = rb_entry(fair_leftmost, pcb_t, run_node)->vruntime;
+        if (vruntime_before(leftmost, vruntime)) {
+            vruntime = leftmost;
+        }
+    }
+    if (vruntime_before(min_vruntime, vruntime)) {
+        min_vruntime = vruntime;
+    }
+}
+
+// 把就绪进程加入当前策略的就绪结构
+void scheduler_add_process(pcb_t* process) {
+    if (!process) return;
+
+    if (current_policy == SCHED_POLICY_FAIR) {
+        fair_add(process);
+    } else {
+        queue_add(process);
+    }
+}
+
+// 从就绪结构中移除进程
+void scheduler_remove_process(pcb_t* process) {
+    if (!process) return;
+
+    if (current_policy == SCHED_POLICY_FAIR) {
+        fair_remove(process);
+    } else {
+        queue_remove(process);
+    }
+}
+
+// 取出下一个要运行的进程：最高级别队列的队首，或vruntime最小的进程；没有就绪进程时返回NULL
+pcb_t* scheduler_pick_next(void) {
+    pcb_t* next = NULL;
+
+    if (current_policy == SCHED_POLICY_FAIR) {
+        if (fair_leftmost) {
+            next = rb_entry(fair_leftmost, pcb_t, run_node);
+        }
+    } else if (ready_bitmap) {
+        next = ready_queues[highest_ready_level()].head;
+    }
+
+    if (next) {
+        scheduler_remove_process(next);
+    }
+    return next;
+}
+
+// 是否有就绪进程
+bool scheduler_has_ready(void) {
+    if (current_policy == SCHED_POLICY_FAIR) {
+        return fair_leftmost != NULL;
+    }
+    return ready_bitmap != 0;
+}
+
+// 是否需要立即抢占current：有更高级别的进程就绪，或者current的vruntime领先最左进程太多
+bool scheduler_should_preempt(pcb_t* current) {
+    if (current_policy == SCHED_POLICY_FAIR) {
+        return fair_leftmost &&
+               (int32_t)(current->vruntime - rb_entry(fair_leftmost, pcb_t, run_node)->vruntime) >
+               FAIR_WAKEUP_GRANULARITY;
+    }
+    return (ready_bitmap >> (priority_level(current->level) + 1)) != 0;
+}
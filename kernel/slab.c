@@ -0,0 +1,338 @@
+#include "slab.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "../drivers/vga/vga.h"
+#include "../lib/string.h"
+
+// 对象缓存池
+static kmem_cache_t cache_pool[KMEM_MAX_CACHES];
+
+// kmalloc使用的2的幂次缓存
+static kmem_cache_t* kmalloc_caches[KMALLOC_CACHE_COUNT];
+static const char* kmalloc_cache_names[KMALLOC_CACHE_COUNT] = {
+    "kmalloc-8", "kmalloc-16", "kmalloc-32", "kmalloc-64",
+    "kmalloc-128", "kmalloc-256", "kmalloc-512", "kmalloc-1024"
+};
+
+// 内部函数声明
+static slab_t* slab_create(kmem_cache_t* cache);
+static void slab_destroy(slab_t* slab);
+static void slab_list_add(slab_t** list, slab_t* slab);
+static void slab_list_remove(slab_t** list, slab_t* slab);
+static slab_t* slab_of(void* obj);
+static uint32_t kmalloc_index(size_t size);
+
+// 初始化slab分配器
+void kmem_init(void) {
+    memset(cache_pool, 0, sizeof(cache_pool));
+    
+    // 创建kmalloc通用缓存
+    uint32_t size = KMALLOC_MIN_SIZE;
+    for (uint32_t i = 0; i < KMALLOC_CACHE_COUNT; i++) {
+        kmalloc_caches[i] = kmem_cache_create(kmalloc_cache_names[i], size, 8, NULL);
+        size <<= 1;
+    }
+}
+
+// 创建对象缓存
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor) {
+    if (!name || size == 0) {
+        return NULL;
+    }
+    
+    if (align < sizeof(uint32_t)) {
+        align = sizeof(uint32_t);
+    }
+    if (align & (align - 1)) {
+        return NULL; // 对齐必须是2的幂
+    }
+    
+    size = (size + align - 1) & ~(align - 1);
+    
+    // 计算每个slab能容纳的对象数（头部 + 索引栈 + 对齐填充 + 对象）
+    uint32_t count = (PAGE_SIZE - sizeof(slab_t)) / (size + sizeof(uint16_t));
+    while (count > 0) {
+        uint32_t objects_offset = sizeof(slab_t) + count * sizeof(uint16_t);
+        objects_offset = (objects_offset + align - 1) & ~(align - 1);
+        if (objects_offset + count * size <= PAGE_SIZE) {
+            break;
+        }
+        count--;
+    }
+    if (count == 0) {
+        return NULL; // 对象太大，放不进一个页面
+    }
+    
+    for (int i = 0; i < KMEM_MAX_CACHES; i++) {
+        if (!cache_pool[i].in_use) {
+            kmem_cache_t* cache = &cache_pool[i];
+            memset(cache, 0, sizeof(kmem_cache_t));
+            strncpy(cache->name, name, KMEM_CACHE_NAME_MAX);
+            cache->name[KMEM_CACHE_NAME_MAX] = '\0';
+            cache->object_size = size;
+            cache->align = align;
+            cache->objects_per_slab = count;
+            cache->ctor = ctor;
+            cache->in_use = true;
+            return cache;
+        }
+    }
+    
+    return NULL;
+}
+
+// 销毁对象缓存（仍有对象在使用时拒绝销毁）
+void kmem_cache_destroy(kmem_cache_t* cache) {
+    if (!cache || !cache->in_use || cache->active_objects) {
+        return;
+    }
+    
+    while (cache->partial) {
+        slab_t* slab = cache->partial;
+        slab_list_remove(&cache->partial, slab);
+        slab_destroy(slab);
+    }
+    kmem_cache_shrink(cache);
+    
+    cache->in_use = false;
+}
+
+// 从缓存中分配一个对象
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (!cache || !cache->in_use) {
+        return NULL;
+    }
+    
+    // 除了kmalloc，内存管理的其他路径也直接调用，自己关中断，免得被抢占时链表处于中间状态
+    uint32_t flags = irq_save();
+    slab_t* slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_create(cache);
+            if (!slab) {
+                irq_restore(flags);
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+    
+    uint16_t index = slab->free_index[--slab->free_count];
+    slab->inuse++;
+    cache->active_objects++;
+    
+    if (slab->free_count == 0) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    
+    irq_restore(flags);
+    return slab->objects + index * cache->object_size;
+}
+
+// 把对象归还给缓存
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!cache || !obj) {
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    slab_t* slab = slab_of(obj);
+    if (!slab || slab->cache != cache) {
+        irq_restore(flags);
+        return;
+    }
+    
+    uint32_t index = ((uint8_t*)obj - slab->objects) / cache->object_size;
+    bool was_full = (slab->free_count == 0);
+    
+    slab->free_index[slab->free_count++] = (uint16_t)index;
+    slab->inuse--;
+    cache->active_objects--;
+    
+    if (was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+    
+    if (slab->inuse == 0) {
+        slab_list_remove(&cache->partial, slab);
+        
+        // 每个缓存保留一个空slab，避免分配/释放在页面边界上反复抖动
+        if (cache->empty) {
+            slab_destroy(slab);
+        } else {
+            slab_list_add(&cache->empty, slab);
+        }
+    }
+    irq_restore(flags);
+}
+
+// 释放缓存中所有空slab
+void kmem_cache_shrink(kmem_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    while (cache->empty) {
+        slab_t* slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_destroy(slab);
+    }
+    irq_restore(flags);
+}
+
+// 释放所有缓存中的空slab（内存回收时调用），返回归还的页数
+uint32_t kmem_shrink_all(void) {
+    uint32_t freed = 0;
+    
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        kmem_cache_t* cache = &cache_pool[i];
+        if (!cache->in_use) {
+            continue;
+        }
+        
+        uint32_t before = cache->slab_count;
+        kmem_cache_shrink(cache);
+        freed += before - cache->slab_count;
+    }
+    return freed;
+}
+
+// 创建新的slab，并对所有对象调用构造函数
+static slab_t* slab_create(kmem_cache_t* cache) {
+    uint32_t page = alloc_physical_page();
+    if (!page) {
+        return NULL;
+    }
+    
+    slab_t* slab = (slab_t*)page;
+    slab->magic = KMEM_SLAB_MAGIC;
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free_count = cache->objects_per_slab;
+    slab->free_index = (uint16_t*)(page + sizeof(slab_t));
+    slab->next = NULL;
+    slab->prev = NULL;
+    
+    uint32_t objects_offset = sizeof(slab_t) + cache->objects_per_slab * sizeof(uint16_t);
+    objects_offset = (objects_offset + cache->align - 1) & ~(cache->align - 1);
+    slab->objects = (uint8_t*)(page + objects_offset);
+    
+    // 索引栈倒序压入，使分配从低地址对象开始
+    for (uint32_t i = 0; i < cache->objects_per_slab; i++) {
+        slab->free_index[i] = (uint16_t)(cache->objects_per_slab - 1 - i);
+        if (cache->ctor) {
+            cache->ctor(slab->objects + i * cache->object_size);
+        }
+    }
+    
+    cache->slab_count++;
+    return slab;
+}
+
+// 销毁slab，归还页面
+static void slab_destroy(slab_t* slab) {
+    slab->cache->slab_count--;
+    slab->magic = 0;
+    free_physical_page((uint32_t)slab);
+}
+
+// 把slab加入链表头
+static void slab_list_add(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+// 从链表中移除slab
+static void slab_list_remove(slab_t** list, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+// 根据对象地址找到所在slab
+static slab_t* slab_of(void* obj) {
+    slab_t* slab = (slab_t*)((uint32_t)obj & ~(PAGE_SIZE - 1));
+    if (slab->magic != KMEM_SLAB_MAGIC) {
+        return NULL;
+    }
+    return slab;
+}
+
+// 计算请求大小对应的kmalloc缓存下标
+static uint32_t kmalloc_index(size_t size) {
+    uint32_t index = 0;
+    size_t class_size = KMALLOC_MIN_SIZE;
+    while (class_size < size) {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+// 小对象kmalloc：从对应的2的幂次缓存中分配
+void* kmalloc_small(size_t size) {
+    if (size == 0 || size > KMALLOC_MAX_SIZE) {
+        return NULL;
+    }
+    return kmem_cache_alloc(kmalloc_caches[kmalloc_index(size)]);
+}
+
+// 判断指针是否属于slab分配器
+bool kmem_owns(void* ptr) {
+    return ptr && slab_of(ptr) != NULL;
+}
+
+// 释放slab对象（无需知道所属缓存）
+void kmem_free(void* ptr) {
+    slab_t* slab = slab_of(ptr);
+    if (slab) {
+        kmem_cache_free(slab->cache, ptr);
+    }
+}
+
+// 获取slab对象的大小
+size_t kmem_object_size(void* ptr) {
+    slab_t* slab = slab_of(ptr);
+    return slab ? slab->cache->object_size : 0;
+}
+
+// 打印所有缓存的信息
+void kmem_print_info(void) {
+    vga_putstr("=== Slab Caches ===\n");
+    vga_putstr("Name            ObjSize  Active   Slabs\n");
+    
+    for (int i = 0; i < KMEM_MAX_CACHES; i++) {
+        kmem_cache_t* cache = &cache_pool[i];
+        if (!cache->in_use) {
+            continue;
+        }
+        
+        vga_putstr(cache->name);
+        for (int j = strlen(cache->name); j < 16; j++) {
+            vga_putstr(" ");
+        }
+        vga_puthex(cache->object_size);
+        vga_putstr(" ");
+        vga_puthex(cache->active_objects);
+        vga_putstr(" ");
+        vga_puthex(cache->slab_count);
+        vga_putstr("\n");
+    }
+}
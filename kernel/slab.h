@@ -0,0 +1,70 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// slab分配器常量
+#define KMEM_MAX_CACHES 32
+#define KMEM_CACHE_NAME_MAX 15
+#define KMEM_SLAB_MAGIC 0x51AB51AB
+#define KMALLOC_MIN_SIZE 8           // 最小的kmalloc缓存
+#define KMALLOC_MAX_SIZE 1024        // 更大的请求走通用堆
+#define KMALLOC_CACHE_COUNT 8        // 8, 16, ..., 1024
+
+// 对象构造函数：对象所在slab创建时调用一次
+typedef void (*kmem_ctor_t)(void* obj);
+
+struct kmem_cache;
+
+// slab描述符（位于每个slab页面的开头）
+typedef struct slab {
+    uint32_t magic;
+    struct kmem_cache* cache;
+    uint32_t inuse;                  // 已分配对象数
+    uint32_t free_count;             // 空闲索引栈深度
+    uint8_t* objects;                // 第一个对象的地址
+    uint16_t* free_index;            // 空闲对象索引栈
+    struct slab* next;
+    struct slab* prev;
+} slab_t;
+
+// 对象缓存
+typedef struct kmem_cache {
+    char name[KMEM_CACHE_NAME_MAX + 1];
+    uint32_t object_size;            // 对齐后的对象大小
+    uint32_t align;                  // 对象对齐
+    uint32_t objects_per_slab;
+    kmem_ctor_t ctor;
+    slab_t* partial;                 // 部分使用的slab
+    slab_t* full;                    // 全部使用的slab
+    slab_t* empty;                   // 空闲slab
+    uint32_t slab_count;
+    uint32_t active_objects;
+    bool in_use;
+} kmem_cache_t;
+
+// 函数声明
+
+// 初始化
+void kmem_init(void);
+
+// 对象缓存管理
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor);
+void kmem_cache_destroy(kmem_cache_t* cache);
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+void kmem_cache_shrink(kmem_cache_t* cache);
+uint32_t kmem_shrink_all(void);
+
+// kmalloc小对象路径
+void* kmalloc_small(size_t size);
+bool kmem_owns(void* ptr);
+void kmem_free(void* ptr);
+size_t kmem_object_size(void* ptr);
+
+// 信息
+void kmem_print_info(void);
+
+#endif // SLAB_H
@@ -0,0 +1,239 @@
+#include "swap.h"
+#include "memory.h"
+#include "zram.h"
+#include "../drivers/vga/vga.h"
+#include "../lib/string.h"
+
+// 交换区：一个设备及其槽位引用表
+typedef struct {
+    const swap_device_t* device;
+    uint8_t* map;                    // 每个槽位的引用数（fork后父子进程共享换出的页面）
+    uint32_t cursor;                 // 下次分配从这里开始找，连续换出的页面落在相邻槽位
+    uint32_t used;
+    int priority;                    // 优先写入优先级高的设备
+} swap_area_t;
+
+// 全局变量
+static swap_area_t swap_areas[SWAP_MAX_DEVICES];
+static uint32_t swap_area_count = 0;
+static uint8_t swap_order[SWAP_MAX_DEVICES]; // 按优先级从高到低排列的设备号
+static swap_stats_t swap_stats = {0};
+
+#ifdef CONFIG_SWAP_RAMDISK
+static uint8_t* swap_ramdisk = NULL;       // RAM盘设备的存储
+
+// RAM盘设备：在vmalloc区域中保留一段内存模拟交换分区
+// 换出的页面仍然占着同样多的内存，只用来测试交换路径，默认不编译（make SWAP_RAMDISK=1）
+static bool ramdisk_read(uint32_t slot, void* page) {
+    memcpy(page, swap_ramdisk + slot * PAGE_SIZE, PAGE_SIZE);
+    return true;
+}
+
+static bool ramdisk_write(uint32_t slot, const void* page) {
+    memcpy(swap_ramdisk + slot * PAGE_SIZE, page, PAGE_SIZE);
+    return true;
+}
+
+static const swap_device_t ramdisk_device = {
+    .name = "ramdisk",
+    .slots = SWAP_RAMDISK_PAGES,
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+    .discard = NULL,
+};
+#endif
+
+// 初始化交换区：页面压缩到内存中的zram；打开CONFIG_SWAP_RAMDISK时放不下的再写到RAM盘
+void swap_init(void) {
+    zram_init();
+    
+#ifdef CONFIG_SWAP_RAMDISK
+    swap_ramdisk = (uint8_t*)vmalloc(SWAP_RAMDISK_PAGES * PAGE_SIZE);
+    if (swap_ramdisk) {
+        swap_register_device(&ramdisk_device, 0);
+    }
+#endif
+    
+    if (!swap_area_count) {
+        vga_putstr("Swap: no swap device\n");
+    }
+}
+
+// 启用交换设备，priority越大越先使用
+bool swap_register_device(const swap_device_t* device, int priority) {
+    if (!device || !device->slots || device->slots > (1U << SWAP_OFFSET_BITS) ||
+        !device->read || !device->write || swap_area_count >= SWAP_MAX_DEVICES) {
+        return false;
+    }
+    
+    uint8_t* map = (uint8_t*)kmalloc(device->slots);
+    if (!map) {
+        return false;
+    }
+    memset(map, 0, device->slots);
+    
+    uint32_t index = swap_area_count++;
+    swap_areas[index].device = device;
+    swap_areas[index].map = map;
+    swap_areas[index].cursor = 0;
+    swap_areas[index].used = 0;
+    swap_areas[index].priority = priority;
+    swap_stats.total_slots += device->slots;
+    
+    // 插入排序维护优先级顺序
+    uint32_t pos = index;
+    while (pos > 0 && swap_areas[swap_order[pos - 1]].priority < priority) {
+        swap_order[pos] = swap_order[pos - 1];
+        pos--;
+    }
+    swap_order[pos] = (uint8_t)index;
+    return true;
+}
+
+// 在交换区中分配一个空闲槽位（循环首次适配）
+static uint32_t swap_area_alloc(swap_area_t* area) {
+    uint32_t slots = area->device->slots;
+    if (area->used >= slots) {
+        return SWAP_NO_SLOT;
+    }
+    
+    for (uint32_t i = 0; i < slots; i++) {
+        uint32_t slot = (area->cursor + i) % slots;
+        if (!area->map[slot]) {
+            area->map[slot] = 1;
+            area->cursor = slot + 1;
+            area->used++;
+            swap_stats.used_slots++;
+            return slot;
+        }
+    }
+    return SWAP_NO_SLOT;
+}
+
+// 把一页写到交换区：按优先级尝试每个设备，返回交换项，全部失败时返回SWAP_NO_SLOT
+uint32_t swap_out(const void* page) {
+    for (uint32_t i = 0; i < swap_area_count; i++) {
+        uint32_t device = swap_order[i];
+        swap_area_t* area = &swap_areas[device];
+        
+        uint32_t slot = swap_area_alloc(area);
+        if (slot == SWAP_NO_SLOT) {
+            continue;
+        }
+        if (area->device->write(slot, page)) {
+            swap_stats.swap_outs++;
+            return SWAP_ENTRY(device, slot);
+        }
+        
+        area->map[slot] = 0;
+        area->used--;
+        swap_stats.used_slots--;
+    }
+    
+    swap_stats.write_failures++;
+    return SWAP_NO_SLOT;
+}
+
+// 取得交换项所在的交换区，交换项无效时返回NULL
+static swap_area_t* swap_entry_area(uint32_t entry) {
+    uint32_t device = SWAP_DEVICE(entry);
+    if (device >= swap_area_count || SWAP_OFFSET(entry) >= swap_areas[device].device->slots) {
+        return NULL;
+    }
+    
+    swap_area_t* area = &swap_areas[device];
+    return area->map[SWAP_OFFSET(entry)] ? area : NULL;
+}
+
+// 增加槽位的引用（fork时复制换出的页表项）
+void swap_dup_slot(uint32_t entry) {
+    swap_area_t* area = swap_entry_area(entry);
+    if (area && area->map[SWAP_OFFSET(entry)] < SWAP_MAP_MAX) {
+        area->map[SWAP_OFFSET(entry)]++;
+    }
+}
+
+// 释放槽位的一个引用，最后一个引用释放时槽位变为空闲
+void swap_free_slot(uint32_t entry) {
+    swap_area_t* area = swap_entry_area(entry);
+    if (!area) {
+        return;
+    }
+    
+    // 引用数饱和后不再精确，槽位只能一直保留
+    uint32_t slot = SWAP_OFFSET(entry);
+    if (area->map[slot] == SWAP_MAP_MAX) {
+        return;
+    }
+    if (--area->map[slot] == 0) {
+        area->used--;
+        swap_stats.used_slots--;
+        if (area->device->discard) {
+            area->device->discard(slot);
+        }
+    }
+}
+
+// 从交换项读回一页
+bool swap_read_page(uint32_t entry, void* page) {
+    swap_area_t* area = swap_entry_area(entry);
+    if (!area || !area->device->read(SWAP_OFFSET(entry), page)) {
+        return false;
+    }
+    swap_stats.swap_ins++;
+    return true;
+}
+
+// 记录一次预读（预读的页面同时计入swap_ins）
+void swap_count_readahead(void) {
+    swap_stats.readahead_pages++;
+}
+
+// 获取交换统计信息
+swap_stats_t* get_swap_stats(void) {
+    return &swap_stats;
+}
+
+// 打印交换区使用情况
+void print_swap_info(void) {
+    vga_putstr("=== Swap Information ===\n");
+    if (!swap_area_count) {
+        vga_putstr("No swap device\n");
+        return;
+    }
+    
+    vga_putstr("Device      Priority  Used        Slots\n");
+    for (uint32_t i = 0; i < swap_area_count; i++) {
+        swap_area_t* area = &swap_areas[swap_order[i]];
+        vga_putstr(area->device->name);
+        for (size_t pad = strlen(area->device->name); pad < 12; pad++) {
+            vga_putchar(' ');
+        }
+        vga_putnum(area->priority);
+        vga_putstr("         ");
+        vga_puthex(area->used);
+        vga_putstr("  ");
+        vga_puthex(area->device->slots);
+        vga_putstr("\n");
+    }
+    
+    vga_putstr("Swapped Out: ");
+    vga_puthex(swap_stats.used_slots * PAGE_SIZE);
+    vga_putstr(" bytes\n");
+    
+    vga_putstr("Swap Outs: ");
+    vga_puthex(swap_stats.swap_outs);
+    vga_putstr("\n");
+    
+    vga_putstr("Swap Ins (readahead): ");
+    vga_puthex(swap_stats.swap_ins);
+    vga_putstr(" (");
+    vga_puthex(swap_stats.readahead_pages);
+    vga_putstr(")\n");
+    
+    vga_putstr("Write Failures: ");
+    vga_puthex(swap_stats.write_failures);
+    vga_putstr("\n");
+    
+    zram_print_info();
+}
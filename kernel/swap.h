@@ -0,0 +1,51 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// 交换区常量
+#define SWAP_MAX_DEVICES 4
+#define SWAP_RAMDISK_PAGES 1024      // RAM盘交换设备的大小（4MB，CONFIG_SWAP_RAMDISK）
+#define SWAP_READAHEAD 4             // 换入时连同读入的相邻槽位数（含缺页的一页）
+#define SWAP_NO_SLOT 0xFFFFFFFF
+#define SWAP_MAP_MAX 0xFF            // 单个槽位的最大引用数
+
+// 交换项编码：页表项的20位地址字段中高2位是设备号，低18位是设备内的槽号
+#define SWAP_OFFSET_BITS 18
+#define SWAP_ENTRY(device, offset) (((device) << SWAP_OFFSET_BITS) | (offset))
+#define SWAP_DEVICE(entry) ((entry) >> SWAP_OFFSET_BITS)
+#define SWAP_OFFSET(entry) ((entry) & ((1U << SWAP_OFFSET_BITS) - 1))
+
+// 交换设备：按页读写的块设备，槽号即设备上的页号
+typedef struct swap_device {
+    const char* name;
+    uint32_t slots;                  // 设备容量（页）
+    bool (*read)(uint32_t slot, void* page);
+    bool (*write)(uint32_t slot, const void* page);   // 设备已满等原因可以拒绝写入
+    void (*discard)(uint32_t slot);  // 槽位不再使用（可为NULL）
+} swap_device_t;
+
+// 交换统计信息
+typedef struct {
+    uint32_t total_slots;
+    uint32_t used_slots;
+    uint32_t swap_outs;              // 写出到交换区的页数
+    uint32_t swap_ins;               // 缺页时读回的页数
+    uint32_t readahead_pages;        // 预读读回的页数
+    uint32_t write_failures;         // 所有设备都无法写入的次数
+} swap_stats_t;
+
+// 函数声明
+void swap_init(void);
+bool swap_register_device(const swap_device_t* device, int priority);
+uint32_t swap_out(const void* page);
+bool swap_read_page(uint32_t entry, void* page);
+void swap_dup_slot(uint32_t entry);
+void swap_free_slot(uint32_t entry);
+void swap_count_readahead(void);
+swap_stats_t* get_swap_stats(void);
+void print_swap_info(void);
+
+#endif // SWAP_H
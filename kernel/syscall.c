@@ -1,6 +1,7 @@
 #include "syscall.h"
 #include "interrupt.h"
 #include "memory.h"
+#include "slab.h"
 #include "../drivers/vga/vga.h"
 #include "../lib/string.h"
 #include <stddef.h>
@@ -12,15 +13,21 @@ static uint32_t syscall_count = 0;
 // 当前系统调用参数（用于调试）
 static syscall_args_t current_syscall_args;
 
+// 打开文件句柄缓存
+static kmem_cache_t* file_cache = NULL;
+
 // 初始化系统调用
 void syscall_init(void) {
     // 清零系统调用表
     memset(syscall_table, 0, sizeof(syscall_table));
     syscall_count = 0;
     
+    // 创建文件句柄缓存
+    file_cache = kmem_cache_create("fs_file", sizeof(fs_file_t), 0, NULL);
+    
     // 注册进程相关系统调用
     syscall_register(SYS_EXIT, sys_exit, "exit", "Terminate current process");
-    syscall_register(SYS_FORK, sys_fork, "fork", "Create new process");
+    syscall_register(SYS_FORK, sys_fork, "fork", "Fork current process (via int 0x80)");
     syscall_register(SYS_EXEC, sys_exec, "exec", "Execute program");
     syscall_register(SYS_WAIT, sys_wait, "wait", "Wait for child process");
     syscall_register(SYS_GETPID, sys_getpid, "getpid", "Get process ID");
@@ -49,14 +56,15 @@ void syscall_init(void) {
     syscall_register(SYS_FREE, sys_free, "free", "Free memory");
     syscall_register(SYS_MMAP, sys_mmap, "mmap", "Map memory");
     syscall_register(SYS_MUNMAP, sys_munmap, "munmap", "Unmap memory");
+    syscall_register(SYS_BRK, sys_brk, "brk", "Set program break");
+    syscall_register(SYS_SBRK, sys_sbrk, "sbrk", "Move program break");
     
     // 注册进程管理相关系统调用
     syscall_register(SYS_PS, sys_ps, "ps", "List processes");
     syscall_register(SYS_SETPRIORITY, sys_setpriority, "setpriority", "Set process priority");
     syscall_register(SYS_GETINFO, sys_getinfo, "getinfo", "Get system information");
     
-    // 设置系统调用中断处理程序
-    idt_set_entry(SYSCALL_INT_NUM, (uint32_t)syscall_handler, 0x08, IDT_ATTR_PRESENT | IDT_ATTR_DPL_3 | IDT_ATTR_32BIT_TRAP);
+    // int 0x80门由idt_init()指向syscall_entry，这里不再改动
 }
 
 // 注册系统调用
@@ -93,6 +101,24 @@ syscall_entry_t* syscall_find(uint32_t syscall_num) {
     return &syscall_table[syscall_num];
 }
 
+// int 0x80入口：syscall_entry传入栈上的陷阱帧，返回值写回帧中的eax
+// 陷阱帧记在当前进程中（嵌套调用时保存外层的），fork据此构造子进程的栈
+void syscall_dispatch(trap_frame_t* frame) {
+    pcb_t* self = process_get_current();
+    trap_frame_t* outer = NULL;
+    if (self) {
+        outer = self->trap_frame;
+        self->trap_frame = frame;
+    }
+    
+    frame->eax = (uint32_t)syscall_execute(frame->eax, frame->ebx, frame->ecx,
+                                           frame->edx, frame->esi, frame->edi);
+    
+    if (self) {
+        self->trap_frame = outer;
+    }
+}
+
 // 执行系统调用
 int32_t syscall_execute(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
     syscall_entry_t* entry = syscall_find(syscall_num);
@@ -112,13 +138,6 @@ int32_t syscall_execute(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint
     return entry->handler(arg1, arg2, arg3, arg4, arg5);
 }
 
-// 系统调用处理程序（汇编调用）
-void syscall_handler(void) {
-    // 这个函数会被汇编代码调用
-    // 参数通过寄存器传递，需要汇编代码来获取
-    // 这里只是占位符，实际的参数获取在汇编代码中完成
-}
-
 // 列出所有系统调用
 void syscall_list(void) {
     vga_putstr("System Calls:\n");
@@ -163,19 +182,20 @@ int32_t sys_exit(uint32_t exit_code, uint32_t arg2, uint32_t arg3, uint32_t arg4
 int32_t sys_fork(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
     (void)arg1; (void)arg2; (void)arg3; (void)arg4; (void)arg5;
     
-    // 简单的fork实现，创建当前进程的副本
-    pcb_t* current = process_get_current();
-    if (!current) {
-        return SYSCALL_ERROR;
+    // 子进程以写时复制方式共享父进程的地址空间，从同一个int 0x80返回，返回值为0
+    int result = process_fork();
+    if (result == PROCESS_ERROR_NO_MEMORY) {
+        return SYSCALL_NO_MEMORY;
+    }
+    if (result == PROCESS_ERROR_INVALID_STATE) {
+        // 没有经int 0x80进入（如shell的syscall命令直接调用）或调用者是空闲进程，子进程无处返回
+        return SYSCALL_ACCESS_DENIED;
     }
-    
-    // 创建新进程（使用当前进程的入口点）
-    int result = process_create("forked_process", (void*)current->eip, current->priority, DEFAULT_STACK_SIZE);
     if (result < 0) {
         return SYSCALL_ERROR;
     }
     
-    return result; // 返回子进程PID
+    return result; // 父进程得到子进程PID
 }
 
 int32_t sys_exec(uint32_t path_ptr, uint32_t argv_ptr, uint32_t envp_ptr, uint32_t arg4, uint32_t arg5) {
@@ -251,14 +271,19 @@ int32_t sys_open(uint32_t path_ptr, uint32_t flags, uint32_t mode, uint32_t arg4
     
     strcpy(path, user_path);
     
-    fs_file_t file;
-    int result = fs_open(path, (uint8_t)flags, &file);
+    fs_file_t* file = (fs_file_t*)kmem_cache_alloc(file_cache);
+    if (!file) {
+        return SYSCALL_NO_MEMORY;
+    }
+    
+    int result = fs_open(path, (uint8_t)flags, file);
     if (result != FS_SUCCESS) {
+        kmem_cache_free(file_cache, file);
         return SYSCALL_ERROR;
     }
     
     // 返回文件描述符（简化实现，直接返回文件句柄地址）
-    return (int32_t)(uintptr_t)&file;
+    return (int32_t)(uintptr_t)file;
 }
 
 int32_t sys_close(uint32_t fd, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
@@ -274,6 +299,7 @@ int32_t sys_close(uint32_t fd, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint
         return SYSCALL_ERROR;
     }
     
+    kmem_cache_free(file_cache, file);
     return SYSCALL_SUCCESS;
 }
 
@@ -589,18 +615,120 @@ int32_t sys_free(uint32_t ptr, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint
     return SYSCALL_SUCCESS;
 }
 
+// 映射只登记区域，页面在首次访问时分配（匿名映射清零，文件映射从文件读入）
+// 参数只有5个，文件映射的偏移取自文件的当前位置，必须按页对齐
 int32_t sys_mmap(uint32_t addr, uint32_t length, uint32_t prot, uint32_t flags, uint32_t fd) {
-    (void)addr; (void)length; (void)prot; (void)flags; (void)fd;
+    memory_context_t* ctx = get_current_memory_context();
+    if (!ctx || length == 0) {
+        return SYSCALL_ERROR;
+    }
     
-    // mmap实现需要虚拟内存管理，这里暂时返回错误
-    return SYSCALL_ERROR;
+    // 只支持私有映射：写入不会回写到文件
+    if ((flags & MAP_SHARED) && !(flags & MAP_ANONYMOUS) && (prot & PROT_WRITE)) {
+        return SYSCALL_ACCESS_DENIED;
+    }
+    
+    uint32_t vm_flags = 0;
+    if (prot & PROT_READ) vm_flags |= VM_READ;
+    if (prot & PROT_WRITE) vm_flags |= VM_WRITE;
+    if (prot & PROT_EXEC) vm_flags |= VM_EXEC;
+    
+    length = align_to_page(length);
+    fs_file_t* file = NULL;
+    if (!(flags & MAP_ANONYMOUS)) {
+        file = (fs_file_t*)(uintptr_t)fd;
+        if (!file || !(file->mode & FS_MODE_READ)) {
+            return SYSCALL_ERROR;
+        }
+    }
+    
+    bool mapped;
+    if (flags & MAP_FIXED) {
+        if (!is_page_aligned(addr)) {
+            return SYSCALL_ERROR;
+        }
+        // 新区域建立成功后才替换原有的映射
+        mapped = map_fixed_region(ctx, addr, addr + length, vm_flags, file, file ? file->offset : 0);
+    } else {
+        addr = find_unmapped_region(ctx, length);
+        if (!addr) {
+            return SYSCALL_NO_MEMORY;
+        }
+        if (file) {
+            mapped = map_file_region(ctx, addr, addr + length, vm_flags, file, file->offset);
+        } else {
+            mapped = map_memory_region(ctx, addr, addr + length, vm_flags);
+        }
+    }
+    
+    if (!mapped) {
+        return SYSCALL_ERROR;
+    }
+    
+    // 用户地址位于高端，按位返回（失败值与MAP_FAILED一样都不是页对齐的）
+    return (int32_t)addr;
 }
 
 int32_t sys_munmap(uint32_t addr, uint32_t length, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
-    (void)addr; (void)length; (void)arg3; (void)arg4; (void)arg5;
+    (void)arg3; (void)arg4; (void)arg5;
     
-    // munmap实现需要虚拟内存管理，这里暂时返回错误
-    return SYSCALL_ERROR;
+    memory_context_t* ctx = get_current_memory_context();
+    if (!ctx || length == 0 || !is_page_aligned(addr)) {
+        return SYSCALL_ERROR;
+    }
+    
+    if (!unmap_memory_region(ctx, addr, addr + length)) {
+        return SYSCALL_ERROR;
+    }
+    
+    return SYSCALL_SUCCESS;
+}
+
+// 更新当前进程PCB中的堆大小，保持与内存上下文一致
+static void sync_process_heap(memory_context_t* ctx) {
+    pcb_t* current = process_get_current();
+    if (current && current->mm == ctx) {
+        current->heap_size = ctx->heap_end - ctx->heap_start;
+    }
+}
+
+// addr为0时查询当前的program break；成功返回新的break，失败返回原来的break（与Linux一致）
+int32_t sys_brk(uint32_t addr, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    (void)arg2; (void)arg3; (void)arg4; (void)arg5;
+    
+    memory_context_t* ctx = get_current_memory_context();
+    if (!ctx) {
+        return SYSCALL_ERROR;
+    }
+    
+    if (addr && set_program_break(ctx, addr)) {
+        sync_process_heap(ctx);
+    }
+    return (int32_t)ctx->heap_end;
+}
+
+// 按有符号增量移动program break，成功返回原来的break
+int32_t sys_sbrk(uint32_t increment, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    (void)arg2; (void)arg3; (void)arg4; (void)arg5;
+    
+    memory_context_t* ctx = get_current_memory_context();
+    if (!ctx) {
+        return SYSCALL_ERROR;
+    }
+    
+    uint32_t old_end = ctx->heap_end;
+    uint32_t new_end = old_end + (int32_t)increment;
+    if (((int32_t)increment > 0 && new_end < old_end) ||
+        ((int32_t)increment < 0 && new_end > old_end)) {
+        return SYSCALL_NO_MEMORY;
+    }
+    
+    if (!set_program_break(ctx, new_end)) {
+        return SYSCALL_NO_MEMORY;
+    }
+    sync_process_heap(ctx);
+    
+    return (int32_t)old_end;
 }
 
 // ==================== 进程管理相关系统调用实现 ====================
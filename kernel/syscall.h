@@ -37,12 +37,24 @@
 #define SYS_FREE            31
 #define SYS_MMAP            32
 #define SYS_MUNMAP          33
+#define SYS_BRK             34
+#define SYS_SBRK            35
 
 // Process management related system calls
 #define SYS_PS              40
 #define SYS_SETPRIORITY     41
 #define SYS_GETINFO         42
 
+// mmap protection and flags
+#define PROT_NONE           0x0
+#define PROT_READ           0x1
+#define PROT_WRITE          0x2
+#define PROT_EXEC           0x4
+#define MAP_SHARED          0x01
+#define MAP_PRIVATE         0x02
+#define MAP_FIXED           0x10
+#define MAP_ANONYMOUS       0x20
+
 // System call error codes
 #define SYSCALL_SUCCESS     0
 #define SYSCALL_ERROR       -1
@@ -82,9 +94,6 @@ typedef struct {
 // System call initialization
 void syscall_init(void);
 
-// System call handler
-void syscall_handler(void);
-
 // System call registration
 int syscall_register(uint32_t syscall_num, syscall_handler_t handler, const char* name, const char* description);
 
@@ -92,6 +101,7 @@ int syscall_register(uint32_t syscall_num, syscall_handler_t handler, const char
 syscall_entry_t* syscall_find(uint32_t syscall_num);
 
 // System call execution
+void syscall_dispatch(trap_frame_t* frame);
 int32_t syscall_execute(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5);
 
 // System call list
@@ -130,6 +140,8 @@ int32_t sys_malloc(uint32_t size, uint32_t arg2, uint32_t arg3, uint32_t arg4, u
 int32_t sys_free(uint32_t ptr, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5);
 int32_t sys_mmap(uint32_t addr, uint32_t length, uint32_t prot, uint32_t flags, uint32_t fd);
 int32_t sys_munmap(uint32_t addr, uint32_t length, uint32_t arg3, uint32_t arg4, uint32_t arg5);
+int32_t sys_brk(uint32_t addr, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5);
+int32_t sys_sbrk(uint32_t increment, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5);
 
 // Process management related system calls
 int32_t sys_ps(uint32_t processes_ptr, uint32_t max_count, uint32_t count_ptr, uint32_t arg4, uint32_t arg5);
@@ -0,0 +1,278 @@
+#include "zram.h"
+#include "memory.h"
+#include "swap.h"
+#include "interrupt.h"
+#include "../drivers/vga/vga.h"
+#include "../lib/string.h"
+#include "../lib/lz.h"
+
+// 压缩数据按64字节分级存放，每个池页只放同一级别的对象
+#define ZRAM_CLASS_SHIFT 6
+#define ZRAM_CLASS_COUNT (ZRAM_MAX_COMPRESSED >> ZRAM_CLASS_SHIFT)
+
+// 每个槽位保存的压缩数据；size为0表示全零页
+typedef struct {
+    void* data;
+    uint32_t size;
+} zram_slot_t;
+
+// 池页头部，放在池页开头
+typedef struct zram_page {
+    struct zram_page* next;          // 同级别未满池页链表
+    struct zram_page* prev;
+    void* free_list;                 // 页内空闲对象（单链表，指针存放在对象中）
+    uint32_t inuse;
+} zram_page_t;
+
+// 全局变量
+static zram_slot_t* zram_slots = NULL;
+static zram_stats_t zram_stats = {0};
+static uint8_t zram_buffer[LZ_COMPRESS_BOUND(PAGE_SIZE)]; // 压缩输出的临时缓冲区
+static zram_page_t* zram_partial[ZRAM_CLASS_COUNT];       // 各级别还有空闲对象的池页
+
+static bool zram_read(uint32_t slot, void* page);
+static bool zram_write(uint32_t slot, const void* page);
+static void zram_discard(uint32_t slot);
+static void* zram_pool_alloc(uint32_t size);
+static void zram_pool_free(void* obj, uint32_t size);
+
+static const swap_device_t zram_device = {
+    .name = "zram",
+    .slots = ZRAM_SLOTS,
+    .read = zram_read,
+    .write = zram_write,
+    .discard = zram_discard,
+};
+
+// 指数移动平均（权重1/8），第一次直接取样本值
+static void update_average(uint32_t* average, uint32_t sample) {
+    *average = *average ? *average - *average / 8 + sample / 8 : sample;
+}
+
+// 初始化zram并注册为最高优先级的交换设备
+bool zram_init(void) {
+    zram_slots = (zram_slot_t*)kcalloc(ZRAM_SLOTS, sizeof(zram_slot_t));
+    if (!zram_slots) {
+        return false;
+    }
+    if (!swap_register_device(&zram_device, ZRAM_PRIORITY)) {
+        kfree(zram_slots);
+        zram_slots = NULL;
+        return false;
+    }
+    return true;
+}
+
+// 页面是否全为0
+static bool page_is_zero(const void* page) {
+    const uint32_t* words = (const uint32_t*)page;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        if (words[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 把池页从所属级别的未满链表中摘除
+static void zram_partial_remove(zram_page_t* pool, uint32_t index) {
+    if (pool->prev) {
+        pool->prev->next = pool->next;
+    } else {
+        zram_partial[index] = pool->next;
+    }
+    if (pool->next) {
+        pool->next->prev = pool->prev;
+    }
+}
+
+// 池页数是否已达到ZRAM_POOL_LIMIT：限制按实际占用的池页计算，而不是压缩数据的字节数
+static bool zram_pool_full(void) {
+    return zram_stats.pool_pages >= ZRAM_POOL_LIMIT / PAGE_SIZE;
+}
+
+// 从池中分配保存size字节压缩数据的空间，需要新池页而池已满时返回NULL
+// zram_write在回收路径上运行，可能正处于堆扩展或slab创建的中途，所以池页直接取自伙伴系统，
+// 既不经过kmalloc，也不会再触发回收
+static void* zram_pool_alloc(uint32_t size) {
+    uint32_t flags = irq_save();
+    
+    uint32_t index = (size - 1) >> ZRAM_CLASS_SHIFT;
+    zram_page_t* pool = zram_partial[index];
+    if (!pool) {
+        pool = zram_pool_full() ? NULL : (zram_page_t*)alloc_physical_pages(0);
+        if (!pool) {
+            irq_restore(flags);
+            return NULL;
+        }
+        
+        // 把头部之后的空间切成该级别的对象
+        uint32_t object_size = (index + 1) << ZRAM_CLASS_SHIFT;
+        pool->free_list = NULL;
+        pool->inuse = 0;
+        for (uint8_t* obj = (uint8_t*)(pool + 1); obj + object_size <= (uint8_t*)pool + PAGE_SIZE;
+             obj += object_size) {
+            *(void**)obj = pool->free_list;
+            pool->free_list = obj;
+        }
+        
+        pool->prev = NULL;
+        pool->next = NULL;
+        zram_partial[index] = pool;
+        zram_stats.pool_pages++;
+    }
+    
+    void* obj = pool->free_list;
+    pool->free_list = *(void**)obj;
+    pool->inuse++;
+    if (!pool->free_list) {
+        zram_partial_remove(pool, index);
+    }
+    
+    irq_restore(flags);
+    return obj;
+}
+
+// 归还压缩数据的空间，池页空了就还给伙伴系统
+static void zram_pool_free(void* obj, uint32_t size) {
+    uint32_t flags = irq_save();
+    
+    uint32_t index = (size - 1) >> ZRAM_CLASS_SHIFT;
+    zram_page_t* pool = (zram_page_t*)((uint32_t)obj & ~(PAGE_SIZE - 1));
+    bool was_full = !pool->free_list;
+    
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->inuse--;
+    
+    if (!pool->inuse) {
+        if (!was_full) {
+            zram_partial_remove(pool, index);
+        }
+        free_physical_page((uint32_t)pool);
+        zram_stats.pool_pages--;
+    } else if (was_full) {
+        pool->prev = NULL;
+        pool->next = zram_partial[index];
+        if (pool->next) {
+            pool->next->prev = pool;
+        }
+        zram_partial[index] = pool;
+    }
+    
+    irq_restore(flags);
+}
+
+// 压缩并保存一页；池满或压缩后超过ZRAM_MAX_COMPRESSED时拒绝，由交换层换到下一个设备
+// 原样保存不可压缩的页面并不省内存，还要多占一个池页
+static bool zram_write(uint32_t slot, const void* page) {
+    zram_slot_t* entry = &zram_slots[slot];
+    
+    if (page_is_zero(page)) {
+        entry->data = NULL;
+        entry->size = 0;
+        zram_stats.stored_pages++;
+        zram_stats.zero_pages++;
+        return true;
+    }
+    
+    uint32_t start = read_tsc();
+    uint32_t size = lz_compress(page, PAGE_SIZE, zram_buffer, ZRAM_MAX_COMPRESSED);
+    update_average(&zram_stats.compress_cycles, read_tsc() - start);
+    
+    if (!size) {
+        zram_stats.incompressible_pages++;
+        return false;
+    }
+    
+    void* store = zram_pool_alloc(size);
+    if (!store) {
+        zram_stats.rejected_pages++;
+        return false;
+    }
+    memcpy(store, zram_buffer, size);
+    
+    entry->data = store;
+    entry->size = size;
+    zram_stats.stored_pages++;
+    zram_stats.pool_bytes += size;
+    return true;
+}
+
+// 解压一页
+static bool zram_read(uint32_t slot, void* page) {
+    zram_slot_t* entry = &zram_slots[slot];
+    
+    if (entry->size == 0) {
+        memset(page, 0, PAGE_SIZE);
+        return true;
+    }
+    uint32_t start = read_tsc();
+    uint32_t size = lz_decompress(entry->data, entry->size, page, PAGE_SIZE);
+    update_average(&zram_stats.decompress_cycles, read_tsc() - start);
+    return size == PAGE_SIZE;
+}
+
+// 槽位释放时归还压缩数据
+static void zram_discard(uint32_t slot) {
+    zram_slot_t* entry = &zram_slots[slot];
+    
+    if (entry->size == 0) {
+        zram_stats.zero_pages--;
+    } else {
+        zram_stats.pool_bytes -= entry->size;
+        zram_pool_free(entry->data, entry->size);
+    }
+    
+    entry->data = NULL;
+    entry->size = 0;
+    zram_stats.stored_pages--;
+}
+
+// 获取zram统计信息
+zram_stats_t* get_zram_stats(void) {
+    return &zram_stats;
+}
+
+// 打印压缩比和压缩耗时
+void zram_print_info(void) {
+    if (!zram_slots) {
+        return;
+    }
+    
+    vga_putstr("=== zram ===\n");
+    vga_putstr("Stored Pages (zero): ");
+    vga_puthex(zram_stats.stored_pages);
+    vga_putstr(" (");
+    vga_puthex(zram_stats.zero_pages);
+    vga_putstr(")\n");
+    
+    vga_putstr("Pool Pages: ");
+    vga_puthex(zram_stats.pool_pages);
+    vga_putstr(" / ");
+    vga_puthex(ZRAM_POOL_LIMIT / PAGE_SIZE);
+    vga_putstr(" (");
+    vga_puthex(zram_stats.pool_bytes);
+    vga_putstr(" bytes used)\n");
+    
+    // 压缩比 = 保存的页数 / 占用的池页数，以百分比显示；池页内的碎片也算作开销
+    vga_putstr("Compression Ratio: ");
+    if (zram_stats.pool_pages) {
+        vga_putnum((int)(zram_stats.stored_pages * 100 / zram_stats.pool_pages));
+        vga_putstr("%\n");
+    } else {
+        vga_putstr("-\n");
+    }
+    
+    vga_putstr("Rejected Pages (pool full/incompressible): ");
+    vga_puthex(zram_stats.rejected_pages);
+    vga_putstr("/");
+    vga_puthex(zram_stats.incompressible_pages);
+    vga_putstr("\n");
+    
+    vga_putstr("Cycles/Page (compress/decompress): ");
+    vga_putnum((int)zram_stats.compress_cycles);
+    vga_putstr(" / ");
+    vga_putnum((int)zram_stats.decompress_cycles);
+    vga_putstr("\n");
+}
@@ -0,0 +1,30 @@
+#ifndef ZRAM_H
+#define ZRAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 压缩内存交换设备：换出的页面经LZ压缩后保存在zram自己的池页中
+#define ZRAM_SLOTS 2048                          // 设备容量（未压缩的页数，8MB）
+#define ZRAM_POOL_LIMIT 0x400000                 // 池页最多占用的内存（4MB）
+#define ZRAM_MAX_COMPRESSED (PAGE_SIZE * 3 / 4)  // 压缩后超过此值的页面不保存，留给下一个交换设备
+#define ZRAM_PRIORITY 100
+
+// zram统计信息
+typedef struct {
+    uint32_t stored_pages;           // 当前保存的页数
+    uint32_t zero_pages;             // 其中全零的页数（不占用存储）
+    uint32_t pool_bytes;             // 压缩数据占用的字节数
+    uint32_t pool_pages;             // 池页数
+    uint32_t rejected_pages;         // 池满被拒绝的页数
+    uint32_t incompressible_pages;   // 压缩后超过ZRAM_MAX_COMPRESSED被拒绝的页数
+    uint32_t compress_cycles;        // 每页压缩耗时（TSC周期，指数移动平均）
+    uint32_t decompress_cycles;      // 每页解压耗时
+} zram_stats_t;
+
+// 函数声明
+bool zram_init(void);
+zram_stats_t* get_zram_stats(void);
+void zram_print_info(void);
+
+#endif // ZRAM_H
@@ -0,0 +1,205 @@
+#include "lz.h"
+#include "string.h"
+#include <stdbool.h>
+
+// 格式：每个序列为 token(高4位字面量长度，低4位匹配长度-4) [长度扩展] 字面量 偏移(2字节小端) [长度扩展]
+// 最后一个序列只有字面量；最后5个字节总是字面量，最后一个匹配至少在结尾12字节之前开始
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MFLIMIT 12
+#define LZ_MAX_OFFSET 0xFFFF
+#define LZ_HASH_LOG 12
+#define LZ_RUN_MASK 15
+
+// 允许非对齐访问的32位读取（x86上是一条指令）
+typedef uint32_t __attribute__((may_alias, aligned(1))) lz_u32_t;
+
+// 哈希表保存输入中的偏移，输入不超过64KB所以用16位（内核单线程使用，放在静态区而不是栈上）
+static uint16_t lz_hash_table[1 << LZ_HASH_LOG];
+
+static inline uint32_t lz_read32(const uint8_t* p) {
+    return *(const lz_u32_t*)p;
+}
+
+static inline uint32_t lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+// 写出长度扩展字节：每个255表示还有后续
+static uint8_t* lz_write_length(uint8_t* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+// 写出一个序列；match_length为0xFFFFFFFF表示最后一个只有字面量的序列
+static uint8_t* lz_write_sequence(uint8_t* op, uint8_t* op_end, const uint8_t* literals,
+                                  size_t literal_length, uint32_t offset, size_t match_length) {
+    bool last = (match_length == (size_t)-1);
+    size_t needed = 1 + literal_length + literal_length / 255 + 1 + (last ? 0 : 2 + match_length / 255 + 1);
+    if ((size_t)(op_end - op) < needed) {
+        return NULL;
+    }
+    
+    uint8_t* token = op++;
+    *token = (uint8_t)((literal_length >= LZ_RUN_MASK ? LZ_RUN_MASK : literal_length) << 4);
+    if (literal_length >= LZ_RUN_MASK) {
+        op = lz_write_length(op, literal_length - LZ_RUN_MASK);
+    }
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+    
+    if (last) {
+        return op;
+    }
+    
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    *token |= (uint8_t)(match_length >= LZ_RUN_MASK ? LZ_RUN_MASK : match_length);
+    if (match_length >= LZ_RUN_MASK) {
+        op = lz_write_length(op, match_length - LZ_RUN_MASK);
+    }
+    return op;
+}
+
+// 压缩：在哈希表中查找最近一次出现的相同4字节，找到后向前、向后扩展匹配
+size_t lz_compress(const void* src, size_t src_len, void* dst, size_t dst_cap) {
+    const uint8_t* in = (const uint8_t*)src;
+    const uint8_t* in_end = in + src_len;
+    const uint8_t* ip = in;
+    const uint8_t* anchor = in;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* op_end = op + dst_cap;
+    
+    if (src_len > LZ_MAX_INPUT) {
+        return 0;
+    }
+    
+    if (src_len > LZ_MFLIMIT) {
+        const uint8_t* match_limit = in_end - LZ_MFLIMIT;
+        const uint8_t* extend_limit = in_end - LZ_LAST_LITERALS;
+        
+        memset(lz_hash_table, 0, sizeof(lz_hash_table));
+        ip++;
+        
+        while (ip < match_limit) {
+            uint32_t sequence = lz_read32(ip);
+            uint32_t h = lz_hash(sequence);
+            const uint8_t* ref = in + lz_hash_table[h];
+            lz_hash_table[h] = (uint16_t)(ip - in);
+            
+            if (ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != sequence) {
+                ip++;
+                continue;
+            }
+            
+            // 向前扩展到上一个序列的末尾
+            while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            
+            const uint8_t* match_end = ip + LZ_MIN_MATCH;
+            const uint8_t* ref_end = ref + LZ_MIN_MATCH;
+            while (match_end < extend_limit && *match_end == *ref_end) {
+                match_end++;
+                ref_end++;
+            }
+            
+            op = lz_write_sequence(op, op_end, anchor, ip - anchor, (uint32_t)(ip - ref),
+                                   match_end - ip - LZ_MIN_MATCH);
+            if (!op) {
+                return 0;
+            }
+            
+            // 匹配中间的位置也登记一个，提高下一次命中的机会
+            if (match_end - 2 > in) {
+                lz_hash_table[lz_hash(lz_read32(match_end - 2))] = (uint16_t)(match_end - 2 - in);
+            }
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+    
+    op = lz_write_sequence(op, op_end, anchor, in_end - anchor, 0, (size_t)-1);
+    if (!op) {
+        return 0;
+    }
+    return op - (uint8_t*)dst;
+}
+
+// 读出长度扩展字节，输入不足时返回false
+static bool lz_read_length(const uint8_t** ip, const uint8_t* in_end, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*ip >= in_end) {
+            return false;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// 解压：每一步都检查输入和输出边界，损坏的数据不会越界写
+size_t lz_decompress(const void* src, size_t src_len, void* dst, size_t dst_cap) {
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* in_end = ip + src_len;
+    uint8_t* out = (uint8_t*)dst;
+    uint8_t* op = out;
+    uint8_t* op_end = out + dst_cap;
+    
+    while (ip < in_end) {
+        uint8_t token = *ip++;
+        
+        size_t literal_length = token >> 4;
+        if (literal_length == LZ_RUN_MASK && !lz_read_length(&ip, in_end, &literal_length)) {
+            return 0;
+        }
+        if (literal_length > (size_t)(in_end - ip) || literal_length > (size_t)(op_end - op)) {
+            return 0;
+        }
+        memcpy(op, ip, literal_length);
+        op += literal_length;
+        ip += literal_length;
+        
+        // 最后一个序列没有匹配部分
+        if (ip == in_end) {
+            break;
+        }
+        
+        if (in_end - ip < 2) {
+            return 0;
+        }
+        uint32_t offset = ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - out)) {
+            return 0;
+        }
+        
+        size_t match_length = token & LZ_RUN_MASK;
+        if (match_length == LZ_RUN_MASK && !lz_read_length(&ip, in_end, &match_length)) {
+            return 0;
+        }
+        match_length += LZ_MIN_MATCH;
+        if (match_length > (size_t)(op_end - op)) {
+            return 0;
+        }
+        
+        // 偏移小于长度时源和目标重叠（重复模式），只能逐字节复制
+        const uint8_t* match = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            while (match_length--) {
+                *op++ = *match++;
+            }
+        }
+    }
+    
+    return op - out;
+}
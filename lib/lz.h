@@ -0,0 +1,19 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ4块格式的快速压缩（单遍哈希匹配，不做熵编码），输入最长64KB
+#define LZ_MAX_INPUT 0x10000
+
+// 输入长度为n时压缩结果的最坏大小
+#define LZ_COMPRESS_BOUND(n) ((n) + (n) / 255 + 16)
+
+// 压缩src，结果放不进dst_cap字节时返回0
+size_t lz_compress(const void* src, size_t src_len, void* dst, size_t dst_cap);
+
+// 解压src，输入损坏或输出超过dst_cap时返回0
+size_t lz_decompress(const void* src, size_t src_len, void* dst, size_t dst_cap);
+
+#endif
@@ -0,0 +1,222 @@
+#include "malloc.h"
+#include "string.h"
+
+// 小块按2的幂分级缓存，大块走首次适配链表
+#define MALLOC_MIN_SHIFT 4                  // 最小的级别：16字节
+#define MALLOC_CLASS_COUNT 8                // 16, 32, ..., 2048
+#define MALLOC_SMALL_MAX (1U << (MALLOC_MIN_SHIFT + MALLOC_CLASS_COUNT - 1))
+#define MALLOC_ALIGN 8
+#define MALLOC_SPLIT_MIN 64                 // 大块拆分后剩余部分的最小可用大小
+#define MALLOC_ARENA_GROW 0x10000           // 每次向内核要64KB
+#define MALLOC_PAGE_SIZE 4096
+#define MALLOC_MAGIC 0x4D414C43
+#define MALLOC_STATE_MAGIC 0x4D535441
+
+// 块头部；next只在空闲时使用，与数据区重叠
+typedef struct malloc_chunk {
+    uint32_t size;                          // 可用字节数
+    uint32_t magic;
+    struct malloc_chunk* next;
+} malloc_chunk_t;
+
+#define CHUNK_HEADER_SIZE offsetof(malloc_chunk_t, next)
+
+// 分配器状态放在进程堆的最开头：每个进程有自己的一份，fork后随堆一起写时复制
+// 内核的.data被所有地址空间共享，不能放全局变量
+// 每个进程只有一个线程，抢占会切换地址空间，所以不需要加锁；同一地址空间里不能有第二个线程调用
+typedef struct {
+    uint32_t magic;
+    malloc_chunk_t* small_free_lists[MALLOC_CLASS_COUNT];
+    malloc_chunk_t* large_free_list;
+    uint32_t arena_current;                 // 尚未切分的堆空间[arena_current, arena_end)
+    uint32_t arena_end;
+} malloc_state_t;
+
+// sbrk失败时返回的是很小的负错误码，合法的用户地址不会落在这个范围
+static int sbrk_failed(int32_t result) {
+    return (uint32_t)result >= (uint32_t)-16;
+}
+
+// 当前进程的分配器状态，经sbrk(0)确认堆的情况：堆还是空的时候在开头建立，
+// 堆开头已被别的代码占用时返回NULL
+static malloc_state_t* malloc_state(void) {
+    int32_t brk = syscall_sbrk(0);
+    if (sbrk_failed(brk)) {
+        return NULL;
+    }
+    
+    malloc_state_t* state = (malloc_state_t*)MALLOC_HEAP_BASE;
+    if ((uint32_t)brk == MALLOC_HEAP_BASE) {
+        if (sbrk_failed(syscall_sbrk(sizeof(malloc_state_t)))) {
+            return NULL;
+        }
+        memset(state, 0, sizeof(malloc_state_t));
+        state->magic = MALLOC_STATE_MAGIC;
+        state->arena_current = MALLOC_HEAP_BASE + sizeof(malloc_state_t);
+        state->arena_end = state->arena_current;
+    } else if (state->magic != MALLOC_STATE_MAGIC) {
+        return NULL;
+    }
+    return state;
+}
+
+// 请求大小对应的小块级别
+static uint32_t size_class(size_t size) {
+    if (size <= (1U << MALLOC_MIN_SHIFT)) {
+        return 0;
+    }
+    return (32 - __builtin_clz(size - 1)) - MALLOC_MIN_SHIFT;
+}
+
+// 从未切分的堆空间中切出total字节，不够时通过sbrk扩展堆
+static malloc_chunk_t* arena_carve(malloc_state_t* state, uint32_t total) {
+    if (total > state->arena_end - state->arena_current) {
+        uint32_t grow = (total + MALLOC_PAGE_SIZE - 1) & ~(MALLOC_PAGE_SIZE - 1);
+        if (grow < MALLOC_ARENA_GROW) {
+            grow = MALLOC_ARENA_GROW;
+        }
+        
+        int32_t old_break = syscall_sbrk((int32_t)grow);
+        if (sbrk_failed(old_break)) {
+            return NULL;
+        }
+        
+        // 别处移动过break时，放弃剩下的一小段
+        if ((uint32_t)old_break != state->arena_end) {
+            state->arena_current = (uint32_t)old_break;
+        }
+        state->arena_end = (uint32_t)old_break + grow;
+    }
+    
+    malloc_chunk_t* chunk = (malloc_chunk_t*)state->arena_current;
+    state->arena_current += total;
+    return chunk;
+}
+
+// 在大块链表中首次适配，剩余部分足够大时拆成新的空闲块
+static malloc_chunk_t* take_large_chunk(malloc_state_t* state, uint32_t size) {
+    malloc_chunk_t** link = &state->large_free_list;
+    while (*link && (*link)->size < size) {
+        link = &(*link)->next;
+    }
+    
+    malloc_chunk_t* chunk = *link;
+    if (!chunk) {
+        return NULL;
+    }
+    *link = chunk->next;
+    
+    if (chunk->size >= size + CHUNK_HEADER_SIZE + MALLOC_SPLIT_MIN) {
+        malloc_chunk_t* rest = (malloc_chunk_t*)((uint32_t)chunk + CHUNK_HEADER_SIZE + size);
+        rest->size = chunk->size - size - CHUNK_HEADER_SIZE;
+        rest->magic = MALLOC_MAGIC;
+        rest->next = state->large_free_list;
+        state->large_free_list = rest;
+        chunk->size = size;
+    }
+    return chunk;
+}
+
+// 分配内存：小块直接从对应级别的链表取；每次调用只用sbrk(0)确认一次状态，堆不够时才扩展
+void* malloc(size_t size) {
+    if (size == 0 || size > 0x7FFFFFFF) {
+        return NULL;
+    }
+    
+    malloc_state_t* state = malloc_state();
+    if (!state) {
+        return NULL;
+    }
+    
+    malloc_chunk_t* chunk;
+    if (size <= MALLOC_SMALL_MAX) {
+        uint32_t class_index = size_class(size);
+        chunk = state->small_free_lists[class_index];
+        if (chunk) {
+            state->small_free_lists[class_index] = chunk->next;
+        } else {
+            uint32_t class_size = 1U << (class_index + MALLOC_MIN_SHIFT);
+            chunk = arena_carve(state, CHUNK_HEADER_SIZE + class_size);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->size = class_size;
+        }
+    } else {
+        uint32_t rounded = (size + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+        chunk = take_large_chunk(state, rounded);
+        if (!chunk) {
+            chunk = arena_carve(state, CHUNK_HEADER_SIZE + rounded);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->size = rounded;
+        }
+    }
+    
+    chunk->magic = MALLOC_MAGIC;
+    return (void*)((uint32_t)chunk + CHUNK_HEADER_SIZE);
+}
+
+// 释放内存：放回对应的空闲链表，页面留在进程堆中供下次分配
+void free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    
+    malloc_chunk_t* chunk = (malloc_chunk_t*)((uint32_t)ptr - CHUNK_HEADER_SIZE);
+    if (chunk->magic != MALLOC_MAGIC) {
+        return; // 不是malloc返回的指针，或者重复释放
+    }
+    
+    malloc_state_t* state = malloc_state();
+    if (!state) {
+        return;
+    }
+    chunk->magic = 0;
+    
+    if (chunk->size <= MALLOC_SMALL_MAX) {
+        uint32_t class_index = size_class(chunk->size);
+        chunk->next = state->small_free_lists[class_index];
+        state->small_free_lists[class_index] = chunk;
+    } else {
+        chunk->next = state->large_free_list;
+        state->large_free_list = chunk;
+    }
+}
+
+void* calloc(size_t num, size_t size) {
+    if (size && num > 0xFFFFFFFF / size) {
+        return NULL;
+    }
+    
+    void* ptr = malloc(num * size);
+    if (ptr) {
+        memset(ptr, 0, num * size);
+    }
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    
+    // 原来的块放得下就原地返回
+    malloc_chunk_t* chunk = (malloc_chunk_t*)((uint32_t)ptr - CHUNK_HEADER_SIZE);
+    if (size <= chunk->size) {
+        return ptr;
+    }
+    
+    void* new_ptr = malloc(size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, chunk->size);
+        free(ptr);
+    }
+    return new_ptr;
+}
@@ -0,0 +1,21 @@
+#ifndef MALLOC_H
+#define MALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 进程堆的起点（内核的USER_SPACE_START，每个地址空间都相同），分配器状态放在这里
+#define MALLOC_HEAP_BASE 0xC0000000
+
+// 用户态内存分配函数声明（在进程堆上切分，状态放在堆的开头，堆不够时通过sbrk扩展）
+// 每个进程单线程使用：状态没有加锁
+void* malloc(size_t size);
+void free(void* ptr);
+void* calloc(size_t num, size_t size);
+void* realloc(void* ptr, size_t size);
+
+// 系统调用包装（syscall_asm.asm）
+int32_t syscall_brk(uint32_t addr);
+int32_t syscall_sbrk(int32_t increment);
+
+#endif
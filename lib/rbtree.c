@@ -0,0 +1,234 @@
+#include "rbtree.h"
+
+// 空子树（NULL）视为黑色
+#define rb_is_red(n) ((n) && (n)->color == RB_RED)
+#define rb_is_black(n) (!rb_is_red(n))
+
+// 用new_node替换old在父节点中的位置
+static void rb_replace_child(rb_node_t* old, rb_node_t* new_node, rb_node_t* parent, rb_root_t* root) {
+    if (!parent) {
+        root->node = new_node;
+    } else if (parent->left == old) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+}
+
+// 以node为支点左旋：node的右孩子上升
+static void rb_rotate_left(rb_node_t* node, rb_root_t* root) {
+    rb_node_t* right = node->right;
+    rb_node_t* parent = node->parent;
+
+    node->right = right->left;
+    if (right->left) {
+        right->left->parent = node;
+    }
+    right->left = node;
+    right->parent = parent;
+    rb_replace_child(node, right, parent, root);
+    node->parent = right;
+}
+
+// 以node为支点右旋：node的左孩子上升
+static void rb_rotate_right(rb_node_t* node, rb_root_t* root) {
+    rb_node_t* left = node->left;
+    rb_node_t* parent = node->parent;
+
+    node->left = left->right;
+    if (left->right) {
+        left->right->parent = node;
+    }
+    left->right = node;
+    left->parent = parent;
+    rb_replace_child(node, left, parent, root);
+    node->parent = left;
+}
+
+// 新插入的红色节点可能与红色父节点相邻，逐级向上修复
+void rb_insert_color(rb_node_t* node, rb_root_t* root) {
+    rb_node_t* parent;
+
+    while ((parent = node->parent) && parent->color == RB_RED) {
+        rb_node_t* grandparent = parent->parent;   // 父节点是红色，一定不是根
+
+        if (parent == grandparent->left) {
+            rb_node_t* uncle = grandparent->right;
+            if (rb_is_red(uncle)) {
+                // 叔叔是红色：父、叔变黑，祖父变红，问题上移两层
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grandparent->color = RB_RED;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grandparent->color = RB_RED;
+            rb_rotate_right(grandparent, root);
+        } else {
+            rb_node_t* uncle = grandparent->left;
+            if (rb_is_red(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grandparent->color = RB_RED;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grandparent->color = RB_RED;
+            rb_rotate_left(grandparent, root);
+        }
+    }
+
+    root->node->color = RB_BLACK;
+}
+
+// 删除黑色节点后，node（可能为NULL）所在的一侧少了一个黑色节点，逐级向上修复
+static void rb_erase_color(rb_node_t* node, rb_node_t* parent, rb_root_t* root) {
+    while (node != root->node && rb_is_black(node)) {
+        if (node == parent->left) {
+            rb_node_t* sibling = parent->right;
+            if (rb_is_red(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->right;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->right)) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rb_rotate_left(parent, root);
+            node = root->node;
+        } else {
+            rb_node_t* sibling = parent->left;
+            if (rb_is_red(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->left;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->left)) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rb_rotate_right(parent, root);
+            node = root->node;
+        }
+    }
+
+    if (node) {
+        node->color = RB_BLACK;
+    }
+}
+
+// 从树中删除节点
+void rb_erase(rb_node_t* node, rb_root_t* root) {
+    rb_node_t* child;
+    rb_node_t* parent;
+    uint32_t color;
+
+    if (node->left && node->right) {
+        // 两个孩子：用后继节点顶替node的位置，实际被摘掉的是后继原来的位置
+        rb_node_t* successor = node->right;
+        while (successor->left) {
+            successor = successor->left;
+        }
+
+        child = successor->right;
+        parent = successor->parent;
+        color = successor->color;
+
+        if (parent == node) {
+            parent = successor;
+        } else {
+            if (child) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            successor->right = node->right;
+            node->right->parent = successor;
+        }
+
+        successor->left = node->left;
+        node->left->parent = successor;
+        successor->parent = node->parent;
+        successor->color = node->color;
+        rb_replace_child(node, successor, node->parent, root);
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+
+        if (child) {
+            child->parent = parent;
+        }
+        rb_replace_child(node, child, parent, root);
+    }
+
+    if (color == RB_BLACK) {
+        rb_erase_color(child, parent, root);
+    }
+}
+
+// 最小（最左）节点，空树返回NULL
+rb_node_t* rb_first(const rb_root_t* root) {
+    rb_node_t* node = root->node;
+    if (!node) {
+        return NULL;
+    }
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+// 中序遍历的下一个节点
+rb_node_t* rb_next(const rb_node_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t*)node;
+    }
+
+    rb_node_t* parent = node->parent;
+    while (parent && node == parent->right) {
+        node = parent;
+        parent = node->parent;
+    }
+    return parent;
+}
@@ -0,0 +1,40 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 侵入式红黑树：节点嵌在宿主结构体中，比较和查找插入位置由调用者完成
+// 插入时调用者沿树找到空位，rb_link_node挂上新节点后调用rb_insert_color恢复平衡
+typedef struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    uint32_t color;
+} rb_node_t;
+
+typedef struct {
+    rb_node_t* node;
+} rb_root_t;
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+// 由节点指针得到宿主结构体
+#define rb_entry(ptr, type, member) ((type*)((char*)(ptr) - offsetof(type, member)))
+
+// 把node挂到parent的*link位置（link为&parent->left、&parent->right或&root->node）
+static inline void rb_link_node(rb_node_t* node, rb_node_t* parent, rb_node_t** link) {
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+}
+
+void rb_insert_color(rb_node_t* node, rb_root_t* root);
+void rb_erase(rb_node_t* node, rb_root_t* root);
+rb_node_t* rb_first(const rb_root_t* root);
+rb_node_t* rb_next(const rb_node_t* node);
+
+#endif